@@ -0,0 +1,584 @@
+//
+// Headless benchmark: renders scripted scenes for a fixed number of frames and reports the results
+//
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "window.h"
+#include "mesh.h"
+#include "meshpool.h"
+#include "dynamicmesh.h"
+#include "shader.h"
+#include "statecache.h"
+#include "renderqueue.h"
+#include "uniformbuffer.h"
+#include "renderstats.h"
+
+namespace
+{
+    const char* vertexShader = SHADER_DIR "shader.vertex";
+    const char* instancedVertexShader = SHADER_DIR "instanced.vertex";
+    const char* fragmentShader = SHADER_DIR "shader.fragment";
+
+    // Program variants for the shader switch scene; each writes a different constant so drivers can't merge them
+    constexpr int switchProgramCount = 8;
+    const char* switchVertexSource = R"(#version 330
+layout (location = 0) in vec3 pos;
+layout (std140) uniform FrameData { mat4 view; mat4 projection; vec4 time; };
+layout (std140) uniform ObjectData { mat4 model; };
+out vec4 vertexColor;
+void main()
+{
+    gl_Position = projection * view * model * vec4(pos, 1.0);
+    vertexColor = vec4(clamp(pos, 0.0, 1.0), 1.0);
+})";
+    const char* switchFragmentTemplate = R"(#version 330
+in vec4 vertexColor;
+out vec4 color;
+void main()
+{
+    color = vertexColor * %d.0 / 8.0;
+})";
+
+    unsigned int tetrahedronIndices[] = {
+            0, 3, 1,
+            1, 3, 2,
+            2, 3, 0,
+            0, 1, 2
+    };
+
+    float tetrahedronVertices[] = {
+            -1.0f, -1.0f, 0.0f,
+            0.0f, -1.0f, 1.0f,
+            1.0f, -1.0f, 0.0f,
+            1.0f, 1.0f, 0.0f
+    };
+
+    // Spreads count objects over a square grid that fills the view at z = -10
+    glm::mat4 gridTransform(unsigned int index, unsigned int count)
+    {
+        auto side = (unsigned int) std::ceil(std::sqrt((double) count));
+        float cell = 8.0f / (float) side;
+        float x = -4.0f + cell * ((float) (index % side) + 0.5f);
+        float y = -4.0f + cell * ((float) (index / side) + 0.5f);
+
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, -10.0f));
+        return glm::scale(transform, glm::vec3(cell * 0.4f));
+    }
+
+    // Each scene owns its GL objects; render() issues one frame's worth of draws
+    class BenchScene
+    {
+    public:
+        virtual ~BenchScene() = default;
+        virtual bool create(unsigned int count) = 0;
+        virtual void render(UniformBuffer& uniforms) = 0;
+    };
+
+    // count separate meshes, sorted and drawn one at a time through the render queue
+    class MeshesScene : public BenchScene
+    {
+    private:
+        std::vector<std::unique_ptr<Mesh>> m_Meshes;
+        std::vector<glm::mat4> m_Transforms;
+        Shader m_Shader;
+        RenderQueue m_Queue;
+    public:
+        bool create(unsigned int count) override
+        {
+            m_Shader.createFromFiles(vertexShader, fragmentShader);
+            for (unsigned int i = 0; i < count; i++)
+            {
+                m_Meshes.emplace_back(std::make_unique<Mesh>());
+                m_Meshes.back()->create(tetrahedronVertices, tetrahedronIndices, 12, 12);
+                m_Transforms.push_back(gridTransform(i, count));
+            }
+            return m_Shader.isReady();
+        }
+
+        void render(UniformBuffer& uniforms) override
+        {
+            for (size_t i = 0; i < m_Meshes.size(); i++)
+            {
+                DrawPacket packet;
+                packet.mesh = m_Meshes[i].get();
+                packet.shader = &m_Shader;
+                packet.transform = m_Transforms[i];
+                packet.depth = -m_Transforms[i][3].z;
+                m_Queue.submit(packet);
+            }
+
+            m_Queue.dispatch(uniforms);
+            m_Queue.clear();
+        }
+    };
+
+    // The same count meshes packed into one pool and drawn with a single multi-draw
+    class PoolScene : public BenchScene
+    {
+    private:
+        MeshPool m_Pool;
+        Shader m_Shader;
+    public:
+        bool create(unsigned int count) override
+        {
+            m_Shader.createFromFiles(vertexShader, fragmentShader);
+
+            // Bake each mesh's grid position into its vertices since the pool shares one transform
+            m_Pool.create(12 * count, 12 * count);
+            for (unsigned int i = 0; i < count; i++)
+            {
+                glm::mat4 transform = gridTransform(i, count);
+                float vertices[12];
+                for (int v = 0; v < 4; v++)
+                {
+                    glm::vec4 position = transform * glm::vec4(tetrahedronVertices[v * 3], tetrahedronVertices[v * 3 + 1],
+                                                               tetrahedronVertices[v * 3 + 2], 1.0f);
+                    vertices[v * 3] = position.x;
+                    vertices[v * 3 + 1] = position.y;
+                    vertices[v * 3 + 2] = position.z;
+                }
+                if (m_Pool.add(vertices, tetrahedronIndices, 12, 12) < 0) return false;
+            }
+            return m_Shader.isReady();
+        }
+
+        void render(UniformBuffer& uniforms) override
+        {
+            unsigned int first = uniforms.beginObjects(1);
+            uniforms.setObject(first, ObjectUniforms());
+            uniforms.endObjects();
+            uniforms.bindObject(first);
+
+            m_Shader.use();
+            m_Pool.render();
+        }
+    };
+
+    // One mesh drawn count times with per-instance transforms re-uploaded every frame
+    class InstancesScene : public BenchScene
+    {
+    private:
+        Mesh m_Mesh;
+        std::vector<glm::mat4> m_Transforms;
+        Shader m_Shader;
+    public:
+        bool create(unsigned int count) override
+        {
+            m_Shader.createFromFiles(instancedVertexShader, fragmentShader);
+            m_Mesh.create(tetrahedronVertices, tetrahedronIndices, 12, 12);
+            for (unsigned int i = 0; i < count; i++) m_Transforms.push_back(gridTransform(i, count));
+            return m_Shader.isReady();
+        }
+
+        void render(UniformBuffer& uniforms) override
+        {
+            unsigned int first = uniforms.beginObjects(1);
+            uniforms.setObject(first, ObjectUniforms());
+            uniforms.endObjects();
+            uniforms.bindObject(first);
+
+            m_Shader.use();
+            m_Mesh.setInstances(m_Transforms.data(), (unsigned int) m_Transforms.size());
+            m_Mesh.renderInstanced((unsigned int) m_Transforms.size());
+        }
+    };
+
+    // count draws of one mesh, changing program before every draw (bypasses the queue, which would group them)
+    class SwitchesScene : public BenchScene
+    {
+    private:
+        Mesh m_Mesh;
+        std::vector<glm::mat4> m_Transforms;
+        Shader m_Shaders[switchProgramCount];
+    public:
+        bool create(unsigned int count) override
+        {
+            for (int i = 0; i < switchProgramCount; i++)
+            {
+                std::vector<char> source(std::strlen(switchFragmentTemplate) + 16);
+                std::snprintf(source.data(), source.size(), switchFragmentTemplate, i + 1);
+                m_Shaders[i].createFromStrings(switchVertexSource, source.data());
+                if (!m_Shaders[i].isReady()) return false;
+            }
+
+            m_Mesh.create(tetrahedronVertices, tetrahedronIndices, 12, 12);
+            for (unsigned int i = 0; i < count; i++) m_Transforms.push_back(gridTransform(i, count));
+            return true;
+        }
+
+        void render(UniformBuffer& uniforms) override
+        {
+            unsigned int first = uniforms.beginObjects((unsigned int) m_Transforms.size());
+            for (size_t i = 0; i < m_Transforms.size(); i++) uniforms.setObject(first + i, ObjectUniforms { m_Transforms[i] });
+            uniforms.endObjects();
+
+            for (size_t i = 0; i < m_Transforms.size(); i++)
+            {
+                m_Shaders[i % switchProgramCount].use();
+                uniforms.bindObject(first + i);
+                m_Mesh.render();
+            }
+        }
+    };
+
+    // A single grid mesh with roughly count vertices, to measure vertex throughput
+    class VerticesScene : public BenchScene
+    {
+    private:
+        Mesh m_Mesh;
+        Shader m_Shader;
+    public:
+        bool create(unsigned int count) override
+        {
+            m_Shader.createFromFiles(vertexShader, fragmentShader);
+
+            auto side = std::max(2u, (unsigned int) std::sqrt((double) count));
+            std::vector<float> vertices;
+            std::vector<unsigned int> indices;
+            vertices.reserve(side * side * 3);
+            indices.reserve((side - 1) * (side - 1) * 6);
+
+            for (unsigned int y = 0; y < side; y++)
+            {
+                for (unsigned int x = 0; x < side; x++)
+                {
+                    float u = (float) x / (float) (side - 1), v = (float) y / (float) (side - 1);
+                    vertices.push_back(u * 8.0f - 4.0f);
+                    vertices.push_back(v * 8.0f - 4.0f);
+                    vertices.push_back(-10.0f + 0.5f * std::sin(u * 20.0f) * std::cos(v * 20.0f));
+                }
+            }
+
+            for (unsigned int y = 0; y + 1 < side; y++)
+            {
+                for (unsigned int x = 0; x + 1 < side; x++)
+                {
+                    unsigned int corner = y * side + x;
+                    indices.insert(indices.end(), { corner, corner + 1, corner + side,
+                                                     corner + 1, corner + side + 1, corner + side });
+                }
+            }
+
+            m_Mesh.create(vertices.data(), indices.data(), (unsigned int) vertices.size(), (unsigned int) indices.size());
+            return m_Shader.isReady();
+        }
+
+        void render(UniformBuffer& uniforms) override
+        {
+            unsigned int first = uniforms.beginObjects(1);
+            uniforms.setObject(first, ObjectUniforms());
+            uniforms.endObjects();
+            uniforms.bindObject(first);
+
+            m_Shader.use();
+            m_Mesh.render();
+        }
+    };
+
+    // A grid of roughly count vertices regenerated on the CPU every frame and streamed to the GPU
+    class DynamicScene : public BenchScene
+    {
+    private:
+        DynamicMesh m_Mesh;
+        Shader m_Shader;
+        unsigned int m_Side = 0, m_Frame = 0;
+    public:
+        bool create(unsigned int count) override
+        {
+            m_Shader.createFromFiles(vertexShader, fragmentShader);
+            m_Side = std::max(2u, (unsigned int) std::sqrt((double) count));
+            m_Mesh.create(m_Side * m_Side * 3, (m_Side - 1) * (m_Side - 1) * 6);
+            return m_Shader.isReady();
+        }
+
+        void render(UniformBuffer& uniforms) override
+        {
+            // Written straight into the stream buffer, no staging copy
+            float* vertices;
+            unsigned int* indices;
+            m_Mesh.beginUpdate(m_Side * m_Side * 3, (m_Side - 1) * (m_Side - 1) * 6, vertices, indices);
+
+            float phase = (float) m_Frame++ * 0.1f;
+            for (unsigned int y = 0; y < m_Side; y++)
+            {
+                for (unsigned int x = 0; x < m_Side; x++)
+                {
+                    float u = (float) x / (float) (m_Side - 1), v = (float) y / (float) (m_Side - 1);
+                    *vertices++ = u * 8.0f - 4.0f;
+                    *vertices++ = v * 8.0f - 4.0f;
+                    *vertices++ = -10.0f + 0.5f * std::sin(u * 20.0f + phase) * std::cos(v * 20.0f);
+                }
+            }
+
+            for (unsigned int y = 0; y + 1 < m_Side; y++)
+            {
+                for (unsigned int x = 0; x + 1 < m_Side; x++)
+                {
+                    unsigned int corner = y * m_Side + x;
+                    *indices++ = corner;
+                    *indices++ = corner + 1;
+                    *indices++ = corner + m_Side;
+                    *indices++ = corner + 1;
+                    *indices++ = corner + m_Side + 1;
+                    *indices++ = corner + m_Side;
+                }
+            }
+            m_Mesh.endUpdate();
+
+            unsigned int first = uniforms.beginObjects(1);
+            uniforms.setObject(first, ObjectUniforms());
+            uniforms.endObjects();
+            uniforms.bindObject(first);
+
+            m_Shader.use();
+            m_Mesh.render();
+        }
+    };
+
+    std::unique_ptr<BenchScene> makeScene(const std::string& name)
+    {
+        if (name == "meshes") return std::make_unique<MeshesScene>();
+        if (name == "pool") return std::make_unique<PoolScene>();
+        if (name == "instances") return std::make_unique<InstancesScene>();
+        if (name == "switches") return std::make_unique<SwitchesScene>();
+        if (name == "vertices") return std::make_unique<VerticesScene>();
+        if (name == "dynamic") return std::make_unique<DynamicScene>();
+        return nullptr;
+    }
+
+    struct SceneRun
+    {
+        std::string name;
+        unsigned int count;
+    };
+
+    // Run when no --scene is given; sizes are picked to finish in seconds on llvmpipe
+    const SceneRun defaultSuite[] = {
+            { "meshes", 1 }, { "meshes", 100 }, { "meshes", 1000 },
+            { "pool", 1000 },
+            { "instances", 1000 }, { "instances", 10000 }, { "instances", 100000 },
+            { "switches", 10 }, { "switches", 100 }, { "switches", 1000 },
+            { "vertices", 1024 }, { "vertices", 65536 }, { "vertices", 262144 },
+            { "dynamic", 1024 }, { "dynamic", 65536 }
+    };
+
+    struct SceneResult
+    {
+        SceneRun run;
+        unsigned int frames = 0;
+        double min = 0.0, average = 0.0, p50 = 0.0, p90 = 0.0, p99 = 0.0, max = 0.0;   // Milliseconds
+        double drawCalls = 0.0, bytesUploaded = 0.0;                                  // Per frame
+        double stateIssued = 0.0, stateElided = 0.0;                                  // Per frame
+    };
+
+    double percentile(const std::vector<double>& sorted, unsigned int percent)
+    {
+        return sorted[std::min(sorted.size() - 1, sorted.size() * percent / 100)];
+    }
+
+    bool runScene(const SceneRun& run, unsigned int warmup, unsigned int frames, SceneResult& result)
+    {
+        std::unique_ptr<BenchScene> scene = makeScene(run.name);
+        if (scene == nullptr)
+        {
+            std::cerr << "Unknown scene \"" << run.name << "\"\n";
+            return false;
+        }
+
+        if (!scene->create(run.count))
+        {
+            std::cerr << "Could not set up scene " << run.name << ':' << run.count << '\n';
+            return false;
+        }
+
+        UniformBuffer uniforms;
+        uniforms.create(std::max(run.count, 1u));
+
+        FrameUniforms frameUniforms;
+        frameUniforms.projection = glm::perspective(45.0f, 600.0f / 800.0f, 0.1f, 300.0f);
+
+        std::vector<double> times;
+        times.reserve(frames);
+
+        for (unsigned int frame = 0; frame < warmup + frames; frame++)
+        {
+            // Only measured frames count towards the totals
+            if (frame == warmup)
+            {
+                RenderStats::reset();
+                GLStateCache::resetCounters();
+            }
+
+            auto start = std::chrono::steady_clock::now();
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            frameUniforms.time.z = (float) frame;
+            uniforms.setFrame(frameUniforms);
+            scene->render(uniforms);
+            uniforms.endFrame();
+
+            // Wait for the frame to finish so the time covers the GPU (llvmpipe threads) as well as the CPU
+            glFinish();
+
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if (frame >= warmup) times.push_back(elapsed.count());
+        }
+
+        std::vector<double> sorted = times;
+        std::sort(sorted.begin(), sorted.end());
+
+        double total = 0.0;
+        for (double time : times) total += time;
+
+        result.run = run;
+        result.frames = frames;
+        result.min = sorted.front();
+        result.max = sorted.back();
+        result.average = total / (double) frames;
+        result.p50 = percentile(sorted, 50);
+        result.p90 = percentile(sorted, 90);
+        result.p99 = percentile(sorted, 99);
+        result.drawCalls = (double) RenderStats::getDrawCalls() / frames;
+        result.bytesUploaded = (double) RenderStats::getBytesUploaded() / frames;
+        result.stateIssued = (double) GLStateCache::getIssuedCount() / frames;
+        result.stateElided = (double) GLStateCache::getElidedCount() / frames;
+        return true;
+    }
+
+    // Driver strings are free text, so quotes and backslashes are escaped like CpuTrace's scope names
+    void writeEscaped(std::ostream& out, const char* text)
+    {
+        for (; *text != '\0'; text++)
+        {
+            if (*text == '"' || *text == '\\') out << '\\';
+            out << *text;
+        }
+    }
+
+    void writeJSON(std::ostream& out, const std::vector<SceneResult>& results)
+    {
+        out << std::fixed << std::setprecision(4);
+        out << "{\n  \"renderer\": \"";
+        writeEscaped(out, (const char*) glGetString(GL_RENDERER));
+        out << "\",\n  \"version\": \"";
+        writeEscaped(out, (const char*) glGetString(GL_VERSION));
+        out << "\",\n  \"scenes\": [\n";
+
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const SceneResult& result = results[i];
+            out << "    { \"scene\": \"" << result.run.name << "\", \"count\": " << result.run.count
+                << ", \"frames\": " << result.frames
+                << ", \"min_ms\": " << result.min << ", \"avg_ms\": " << result.average
+                << ", \"p50_ms\": " << result.p50 << ", \"p90_ms\": " << result.p90
+                << ", \"p99_ms\": " << result.p99 << ", \"max_ms\": " << result.max
+                << ", \"draw_calls\": " << result.drawCalls << ", \"bytes_uploaded\": " << result.bytesUploaded
+                << ", \"state_issued\": " << result.stateIssued << ", \"state_elided\": " << result.stateElided
+                << " }" << (i + 1 < results.size() ? "," : "") << '\n';
+        }
+
+        out << "  ]\n}\n";
+    }
+
+    void writeCSV(std::ostream& out, const std::vector<SceneResult>& results)
+    {
+        out << std::fixed << std::setprecision(4);
+        out << "scene,count,frames,min_ms,avg_ms,p50_ms,p90_ms,p99_ms,max_ms,"
+               "draw_calls,bytes_uploaded,state_issued,state_elided\n";
+
+        for (const SceneResult& result : results)
+        {
+            out << result.run.name << ',' << result.run.count << ',' << result.frames << ','
+                << result.min << ',' << result.average << ',' << result.p50 << ',' << result.p90 << ','
+                << result.p99 << ',' << result.max << ',' << result.drawCalls << ',' << result.bytesUploaded << ','
+                << result.stateIssued << ',' << result.stateElided << '\n';
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // Command-line options: --scene name:count (repeatable; defaults to the built-in suite),
+    // --frames N measured frames per scene, --warmup N unmeasured frames first,
+    // --format json|csv, --output file (defaults to stdout)
+    std::vector<SceneRun> runs;
+    unsigned int frames = 100, warmup = 10;
+    const char* format = "json";
+    const char* outputPath = nullptr;
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--scene") == 0 && arg + 1 < argc)
+        {
+            std::string scene = argv[++arg];
+            size_t colon = scene.find(':');
+            unsigned int count = colon == std::string::npos ? 1 : std::strtoul(scene.c_str() + colon + 1, nullptr, 10);
+            runs.push_back({ scene.substr(0, colon), count });
+        }
+        else if (strcmp(argv[arg], "--frames") == 0 && arg + 1 < argc) frames = std::strtoul(argv[++arg], nullptr, 10);
+        else if (strcmp(argv[arg], "--warmup") == 0 && arg + 1 < argc) warmup = std::strtoul(argv[++arg], nullptr, 10);
+        else if (strcmp(argv[arg], "--format") == 0 && arg + 1 < argc) format = argv[++arg];
+        else if (strcmp(argv[arg], "--output") == 0 && arg + 1 < argc) outputPath = argv[++arg];
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--scene meshes|pool|instances|switches|vertices|dynamic:N]..."
+                      << " [--frames N] [--warmup N] [--format json|csv] [--output file]\n";
+            return 1;
+        }
+    }
+
+    if (strcmp(format, "json") != 0 && strcmp(format, "csv") != 0)
+    {
+        std::cerr << "Unknown format \"" << format << "\"\n";
+        return 1;
+    }
+    if (frames == 0) frames = 1;
+    if (runs.empty()) runs.assign(std::begin(defaultSuite), std::end(defaultSuite));
+
+    GLWindow window(800, 600, WindowBackend::Headless);
+    if (window.init() != 0) return 1;
+
+    GLStateCache::enable(GL_DEPTH_TEST);
+    glViewport(0, 0, window.getBufferWidth(), window.getBufferHeight());
+
+    std::vector<SceneResult> results;
+    for (const SceneRun& run : runs)
+    {
+        SceneResult result;
+        if (!runScene(run, warmup, frames, result)) return 1;
+        results.push_back(result);
+
+        // Progress goes to stderr so stdout stays machine-readable
+        std::cerr << run.name << ':' << run.count << "  p50 " << result.p50 << " ms\n";
+    }
+
+    std::ofstream file;
+    if (outputPath != nullptr)
+    {
+        file.open(outputPath);
+        if (!file)
+        {
+            std::cerr << "Could not open " << outputPath << " for writing\n";
+            return 1;
+        }
+    }
+
+    std::ostream& out = outputPath != nullptr ? file : std::cout;
+    if (strcmp(format, "csv") == 0) writeCSV(out, results);
+    else writeJSON(out, results);
+    return 0;
+}
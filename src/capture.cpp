@@ -0,0 +1,233 @@
+//
+// Asynchronous frame capture to PNG sequences or Y4M video
+//
+
+#include "capture.h"
+#include "image.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+FrameCapture::~FrameCapture()
+{
+    if (isActive()) finish();
+}
+
+bool FrameCapture::create(unsigned int width, unsigned int height, CaptureFormat format, const char* path,
+                          unsigned int threads, unsigned int frameRate)
+{
+    m_Width = width;
+    m_Height = height;
+    m_Format = format;
+    m_Path = path;
+    m_Frame = 0;
+    m_NextWrite = 0;
+    m_Encoded = m_Failed = 0;
+    m_Stopping = false;
+
+    if (format == CaptureFormat::Y4M)
+    {
+        m_File = std::fopen(path, "wb");
+        if (m_File == nullptr)
+        {
+            std::cout << "Could not open " << path << " for writing\n";
+            return false;
+        }
+
+        // C420jpeg: full-range BT.601 with chroma sited between pixels, which is what encodeY4M() produces
+        std::fprintf(m_File, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, frameRate);
+    }
+
+    for (PixelReadback& readback : m_Readbacks) readback.create(width, height);
+
+    // hardware_concurrency() may report 0 when the core count is unknown
+    unsigned int cores = std::thread::hardware_concurrency();
+    if (threads == 0) threads = cores > 1 ? cores - 1 : 1;
+
+    // Bound the backlog so a slow encoder throttles rendering instead of eating memory
+    m_MaxQueued = threads * 2;
+    for (unsigned int i = 0; i < threads; i++) m_Workers.emplace_back(&FrameCapture::workerLoop, this);
+    return true;
+}
+
+void FrameCapture::capture()
+{
+    if (!isActive()) return;
+    TRACE_SCOPE("FrameCapture::capture");
+
+    // The slot about to be reused holds the oldest readback, which has almost certainly landed
+    int slot = (int) (m_Frame % ringSize);
+    if (m_Readbacks[slot].isPending()) collect(slot);
+
+    m_SlotFrames[slot] = m_Frame++;
+    m_Readbacks[slot].begin();
+}
+
+void FrameCapture::collect(int slot)
+{
+    std::vector<unsigned char> pixels;
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_WorkDone.wait(lock, [this] { return m_Jobs.size() < m_MaxQueued; });
+
+        if (!m_FreeBuffers.empty())
+        {
+            pixels = std::move(m_FreeBuffers.back());
+            m_FreeBuffers.pop_back();
+        }
+    }
+
+    // The only per-frame work left on the GL thread: one copy out of the mapped buffer
+    PixelReadback& readback = m_Readbacks[slot];
+    pixels.resize(readback.getSize());
+    const unsigned char* rows = readback.map();
+    if (rows != nullptr) std::memcpy(pixels.data(), rows, pixels.size());
+    readback.unmap();
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Jobs.push_back({ m_SlotFrames[slot], std::move(pixels) });
+    }
+    m_WorkReady.notify_one();
+}
+
+void FrameCapture::finish()
+{
+    if (!isActive()) return;
+
+    // Oldest first so Y4M frames stay in order
+    for (int i = 0; i < ringSize; i++)
+    {
+        int slot = (int) ((m_Frame + i) % ringSize);
+        if (m_Readbacks[slot].isPending()) collect(slot);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_WorkReady.notify_all();
+
+    for (std::thread& worker : m_Workers) worker.join();
+    m_Workers.clear();
+    m_FreeBuffers.clear();
+
+    for (PixelReadback& readback : m_Readbacks) readback.clear();
+
+    if (m_File != nullptr)
+    {
+        std::fclose(m_File);
+        m_File = nullptr;
+    }
+}
+
+void FrameCapture::workerLoop()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_WorkReady.wait(lock, [this] { return m_Stopping || !m_Jobs.empty(); });
+
+            // Only exit once the queue is drained
+            if (m_Jobs.empty()) return;
+            job = std::move(m_Jobs.front());
+            m_Jobs.pop_front();
+        }
+        m_WorkDone.notify_one();
+
+        bool encoded = m_Format == CaptureFormat::PNG ? encodePNG(job) : encodeY4M(job);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (encoded) m_Encoded++;
+        else m_Failed++;
+        m_FreeBuffers.push_back(std::move(job.pixels));
+    }
+}
+
+bool FrameCapture::encodePNG(const Job& job)
+{
+    Image image;
+    image.setFromFramebuffer(job.pixels.data(), m_Width, m_Height);
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "/frame_%06u.png", job.frame);
+    return image.savePNG((m_Path + name).c_str());
+}
+
+bool FrameCapture::encodeY4M(const Job& job)
+{
+    // Convert outside the lock; only the write itself is serialized
+    unsigned int chromaWidth = (m_Width + 1) / 2, chromaHeight = (m_Height + 1) / 2;
+    size_t lumaSize = (size_t) m_Width * m_Height, chromaSize = (size_t) chromaWidth * chromaHeight;
+    std::vector<unsigned char> planes(lumaSize + chromaSize * 2);
+    unsigned char* lumaPlane = planes.data();
+    unsigned char* uPlane = lumaPlane + lumaSize;
+    unsigned char* vPlane = uPlane + chromaSize;
+
+    // Full-range BT.601; GL rows are bottom-up, Y4M rows top-down
+    auto pixelAt = [&](unsigned int x, unsigned int y)
+    {
+        return job.pixels.data() + ((size_t) (m_Height - 1 - y) * m_Width + x) * 4;
+    };
+
+    for (unsigned int y = 0; y < m_Height; y++)
+    {
+        for (unsigned int x = 0; x < m_Width; x++)
+        {
+            const unsigned char* pixel = pixelAt(x, y);
+            float luma = 0.299f * pixel[0] + 0.587f * pixel[1] + 0.114f * pixel[2];
+            lumaPlane[(size_t) y * m_Width + x] = (unsigned char) std::clamp(luma + 0.5f, 0.0f, 255.0f);
+        }
+    }
+
+    // Chroma from the average of each 2x2 block (clamped at odd edges)
+    for (unsigned int y = 0; y < chromaHeight; y++)
+    {
+        for (unsigned int x = 0; x < chromaWidth; x++)
+        {
+            float r = 0.0f, g = 0.0f, b = 0.0f;
+            for (unsigned int dy = 0; dy < 2; dy++)
+            {
+                for (unsigned int dx = 0; dx < 2; dx++)
+                {
+                    const unsigned char* pixel = pixelAt(std::min(x * 2 + dx, m_Width - 1), std::min(y * 2 + dy, m_Height - 1));
+                    r += pixel[0];
+                    g += pixel[1];
+                    b += pixel[2];
+                }
+            }
+            r *= 0.25f;
+            g *= 0.25f;
+            b *= 0.25f;
+
+            float u = 128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b;
+            float v = 128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b;
+            uPlane[(size_t) y * chromaWidth + x] = (unsigned char) std::clamp(u + 0.5f, 0.0f, 255.0f);
+            vPlane[(size_t) y * chromaWidth + x] = (unsigned char) std::clamp(v + 0.5f, 0.0f, 255.0f);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Written.wait(lock, [&] { return m_NextWrite == job.frame; });
+
+    bool written = std::fputs("FRAME\n", m_File) >= 0 && std::fwrite(planes.data(), 1, planes.size(), m_File) == planes.size();
+    m_NextWrite++;
+    m_Written.notify_all();
+    return written;
+}
+
+unsigned int FrameCapture::getEncodedCount()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Encoded;
+}
+
+unsigned int FrameCapture::getFailedCount()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Failed;
+}
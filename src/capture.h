@@ -0,0 +1,88 @@
+//
+// Asynchronous frame capture to PNG sequences or Y4M video
+//
+
+#pragma once
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "readback.h"
+
+enum class CaptureFormat
+{
+    PNG,    // One numbered PNG per frame in a directory
+    Y4M     // A single uncompressed YUV 4:2:0 video stream
+};
+
+/* Captures every frame without stalling the GL thread. capture() queues a readback into a ring of
+ * pixel pack buffers and only maps the one written ringSize frames earlier, whose copy has long
+ * finished. The mapped pixels are copied into a recycled buffer and handed to worker threads that
+ * flip and encode them; Y4M frames are written in order as they complete.
+ *
+ *     capture.create(width, height, CaptureFormat::PNG, "frames/");
+ *     while (...) { render(); capture.capture(); window.swapBuffers(); }
+ *     capture.finish();
+ */
+class FrameCapture
+{
+public:
+    FrameCapture() = default;
+    ~FrameCapture();
+private:
+    static constexpr int ringSize = 3;
+
+    struct Job
+    {
+        unsigned int frame;
+        std::vector<unsigned char> pixels;      // Bottom-up RGBA8 rows, as read back
+    };
+
+    unsigned int m_Width = 0, m_Height = 0;
+    CaptureFormat m_Format = CaptureFormat::PNG;
+    std::string m_Path;
+    unsigned int m_Frame = 0;
+    unsigned int m_MaxQueued = 0;
+
+    // Oldest slot first: m_Readbacks[(m_Frame + i) % ringSize]
+    PixelReadback m_Readbacks[ringSize];
+    unsigned int m_SlotFrames[ringSize] {};
+
+    // Worker state; everything below the mutex is shared with the workers
+    std::vector<std::thread> m_Workers;
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkReady, m_WorkDone, m_Written;
+    std::deque<Job> m_Jobs;
+    std::vector<std::vector<unsigned char>> m_FreeBuffers;
+    bool m_Stopping = false;
+    unsigned int m_Encoded = 0, m_Failed = 0;
+
+    // Y4M output; frames are appended strictly in order
+    FILE* m_File = nullptr;
+    unsigned int m_NextWrite = 0;
+private:
+    void collect(int slot);
+    void workerLoop();
+    bool encodePNG(const Job& job);
+    bool encodeY4M(const Job& job);
+public:
+    // For PNG, path is a directory (which must exist); for Y4M, the output file.
+    // threads = 0 picks one per hardware thread, leaving one for the GL thread
+    bool create(unsigned int width, unsigned int height, CaptureFormat format, const char* path,
+                unsigned int threads = 0, unsigned int frameRate = 60);
+
+    // Reads the bound read framebuffer; call once per frame after rendering, before swapping
+    void capture();
+
+    // Collects outstanding readbacks and waits for every frame to be written
+    void finish();
+
+    constexpr bool isActive() const { return !m_Workers.empty(); }
+    unsigned int getEncodedCount();
+    unsigned int getFailedCount();
+};
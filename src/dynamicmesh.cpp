@@ -0,0 +1,108 @@
+//
+// Mesh whose geometry is rewritten every frame
+//
+
+#include "dynamicmesh.h"
+#include "statecache.h"
+#include "vertexlayout.h"
+#include "renderstats.h"
+#include "trace.h"
+
+#include <cstring>
+
+DynamicMesh::DynamicMesh() : m_VAO(0), m_AttachedVBO(0), m_AttachedIBO(0), m_IndexCount(0), m_BaseVertex(0),
+                             m_IndexOffset(0), m_Updated(false)
+{}
+
+DynamicMesh::~DynamicMesh()
+{
+    clear();
+}
+
+void DynamicMesh::create(unsigned int vertexCapacity, unsigned int indexCapacity)
+{
+    glGenVertexArrays(1, &m_VAO);
+    m_Vertices.create(sizeof(float) * vertexCapacity);
+    m_Indices.create(sizeof(unsigned int) * indexCapacity);
+    attachBuffers();
+}
+
+void DynamicMesh::attachBuffers()
+{
+    // Growing a stream buffer can replace it, and the VAO holds on to buffer names
+    if (m_AttachedVBO == m_Vertices.getBuffer() && m_AttachedIBO == m_Indices.getBuffer()) return;
+
+    GLStateCache::bindVertexArray(m_VAO);
+    GLStateCache::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Indices.getBuffer());
+    GLStateCache::bindBuffer(GL_ARRAY_BUFFER, m_Vertices.getBuffer());
+    VertexLayout::positions().apply();
+
+    m_AttachedVBO = m_Vertices.getBuffer();
+    m_AttachedIBO = m_Indices.getBuffer();
+}
+
+void DynamicMesh::update(const float* vertices, const unsigned int* indices, unsigned int vertexCount, unsigned int indexCount)
+{
+    float* vertexData;
+    unsigned int* indexData;
+    beginUpdate(vertexCount, indexCount, vertexData, indexData);
+    std::memcpy(vertexData, vertices, sizeof(float) * vertexCount);
+    std::memcpy(indexData, indices, sizeof(unsigned int) * indexCount);
+    endUpdate();
+}
+
+void DynamicMesh::beginUpdate(unsigned int vertexCount, unsigned int indexCount, float*& vertices, unsigned int*& indices)
+{
+    TRACE_SCOPE("DynamicMesh::update");
+
+    // The previous update's draws have been issued by now, so its segments can be fenced
+    if (m_Updated)
+    {
+        m_Vertices.endFrame();
+        m_Indices.endFrame();
+    }
+
+    // Vertices start on a whole vertex so the draw can address them with a base vertex
+    const size_t vertexStride = sizeof(float) * 3;
+    size_t vertexOffset, indexOffset;
+    vertices = (float*) m_Vertices.allocate(sizeof(float) * vertexCount, vertexStride, vertexOffset);
+    indices = (unsigned int*) m_Indices.allocate(sizeof(unsigned int) * indexCount, sizeof(unsigned int), indexOffset);
+
+    m_BaseVertex = (int) (vertexOffset / vertexStride);
+    m_IndexOffset = indexOffset;
+    m_IndexCount = indexCount;
+    m_Updated = true;
+}
+
+void DynamicMesh::endUpdate()
+{
+    m_Vertices.flush();
+    m_Indices.flush();
+    attachBuffers();
+}
+
+void DynamicMesh::render()
+{
+    if (!m_Updated || m_IndexCount == 0) return;
+
+    GLStateCache::bindVertexArray(m_VAO);
+    glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei) m_IndexCount, GL_UNSIGNED_INT, (const void*) m_IndexOffset, m_BaseVertex);
+    RenderStats::countDraw();
+}
+
+void DynamicMesh::clear()
+{
+    m_Vertices.clear();
+    m_Indices.clear();
+
+    if (m_VAO != 0)
+    {
+        GLStateCache::forgetVertexArray(m_VAO);
+        glDeleteVertexArrays(1, &m_VAO);
+        m_VAO = 0;
+    }
+
+    m_AttachedVBO = m_AttachedIBO = 0;
+    m_IndexCount = 0;
+    m_Updated = false;
+}
@@ -0,0 +1,45 @@
+//
+// Mesh whose geometry is rewritten every frame
+//
+
+#pragma once
+#include <GL/glew.h>
+
+#include "streambuffer.h"
+
+/* Same vertex format as Mesh (position at location 0), but vertices and indices are streamed
+ * through StreamBuffers instead of living in static buffers, so geometry generated on the CPU each
+ * frame doesn't need a new Mesh or stall on draws still reading last frame's data.
+ *
+ * Call update() (or beginUpdate()/endUpdate() to generate straight into the buffers) once per frame
+ * before render(); each update starts a new frame's segment.
+ */
+class DynamicMesh
+{
+public:
+    DynamicMesh();
+    ~DynamicMesh();
+private:
+    StreamBuffer m_Vertices, m_Indices;
+    unsigned int m_VAO;
+    unsigned int m_AttachedVBO, m_AttachedIBO;     // Buffers the VAO currently points at
+    unsigned int m_IndexCount;
+    int m_BaseVertex;
+    size_t m_IndexOffset;
+    bool m_Updated;
+private:
+    void attachBuffers();
+public:
+    // Capacities are per frame, in floats and indices like Mesh::create(); both grow if exceeded
+    void create(unsigned int vertexCapacity, unsigned int indexCapacity);
+
+    void update(const float* vertices, const unsigned int* indices, unsigned int vertexCount, unsigned int indexCount);
+    void beginUpdate(unsigned int vertexCount, unsigned int indexCount, float*& vertices, unsigned int*& indices);
+    void endUpdate();
+
+    void render();
+    void clear();
+
+    constexpr unsigned int getVAO() const { return m_VAO; }
+    constexpr bool isPersistent() const { return m_Vertices.isPersistent(); }
+};
@@ -0,0 +1,629 @@
+//
+// glTF 2.0 binary (.glb) loading
+//
+
+#include "gltfloader.h"
+#include "mappedfile.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <string_view>
+#include <utility>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace
+{
+    // --- JSON ---
+
+    // Just enough JSON for glTF: a DOM of values with lookups that return null when missing
+    class JsonValue
+    {
+    public:
+        enum class Type { Null, Bool, Number, String, Array, Object };
+
+        Type type = Type::Null;
+        bool boolean = false;
+        double number = 0.0;
+        std::string string;
+        std::vector<JsonValue> array;
+        std::vector<std::pair<std::string, JsonValue>> object;
+
+        const JsonValue& operator[](std::string_view key) const
+        {
+            for (const auto& [name, value] : object)
+                if (name == key) return value;
+            return null();
+        }
+
+        const JsonValue& operator[](size_t index) const { return index < array.size() ? array[index] : null(); }
+
+        size_t size() const { return array.size(); }
+        bool isNull() const { return type == Type::Null; }
+        bool isNumber() const { return type == Type::Number; }
+        bool isString() const { return type == Type::String; }
+
+        double getNumber(double fallback) const { return isNumber() ? number : fallback; }
+        // Out-of-range (and NaN) numbers give the fallback; converting them would be undefined
+        int getInt(int fallback) const
+        {
+            return isNumber() && number >= INT_MIN && number <= INT_MAX ? (int) number : fallback;
+        }
+
+        // Capped at 2^53, past which doubles stop being exact integers anyway
+        size_t getSize(size_t fallback) const
+        {
+            return isNumber() && number >= 0.0 && number <= 9007199254740992.0 ? (size_t) number : fallback;
+        }
+    private:
+        static const JsonValue& null()
+        {
+            static const JsonValue value;
+            return value;
+        }
+    };
+
+    class JsonParser
+    {
+    private:
+        const char* m_Position;
+        const char* m_End;
+        int m_Depth = 0;
+
+        // Deep enough for any glTF file, shallow enough that the recursion can't blow the stack
+        static constexpr int maxDepth = 64;
+    public:
+        JsonParser(const char* begin, const char* end) : m_Position(begin), m_End(end)
+        {}
+
+        bool parse(JsonValue& value)
+        {
+            if (!parseValue(value)) return false;
+            skipWhitespace();
+            return m_Position == m_End;
+        }
+    private:
+        void skipWhitespace()
+        {
+            while (m_Position < m_End && (*m_Position == ' ' || *m_Position == '\t' || *m_Position == '\n' ||
+                                          *m_Position == '\r'))
+                m_Position++;
+        }
+
+        bool consume(char c)
+        {
+            skipWhitespace();
+            if (m_Position == m_End || *m_Position != c) return false;
+            m_Position++;
+            return true;
+        }
+
+        bool literal(std::string_view text)
+        {
+            if ((size_t) (m_End - m_Position) < text.size() || std::string_view(m_Position, text.size()) != text)
+                return false;
+            m_Position += text.size();
+            return true;
+        }
+
+        bool parseValue(JsonValue& value)
+        {
+            skipWhitespace();
+            if (m_Position == m_End || ++m_Depth > maxDepth) return false;
+
+            bool parsed;
+            switch (*m_Position)
+            {
+                case '{': parsed = parseObject(value); break;
+                case '[': parsed = parseArray(value); break;
+                case '"':
+                    value.type = JsonValue::Type::String;
+                    parsed = parseString(value.string);
+                    break;
+                case 't':
+                case 'f':
+                    value.type = JsonValue::Type::Bool;
+                    value.boolean = *m_Position == 't';
+                    parsed = literal(value.boolean ? "true" : "false");
+                    break;
+                case 'n': parsed = literal("null"); break;
+                default:
+                {
+                    // from_chars takes no leading '+', and neither does JSON
+                    value.type = JsonValue::Type::Number;
+                    auto result = std::from_chars(m_Position, m_End, value.number);
+                    parsed = result.ec == std::errc();
+                    m_Position = result.ptr;
+                }
+            }
+
+            m_Depth--;
+            return parsed;
+        }
+
+        bool parseObject(JsonValue& value)
+        {
+            value.type = JsonValue::Type::Object;
+            m_Position++;
+            if (consume('}')) return true;
+
+            do
+            {
+                auto& [name, member] = value.object.emplace_back();
+                skipWhitespace();
+                if (m_Position == m_End || *m_Position != '"' || !parseString(name) || !consume(':') ||
+                    !parseValue(member))
+                    return false;
+            } while (consume(','));
+            return consume('}');
+        }
+
+        bool parseArray(JsonValue& value)
+        {
+            value.type = JsonValue::Type::Array;
+            m_Position++;
+            if (consume(']')) return true;
+
+            do
+            {
+                if (!parseValue(value.array.emplace_back())) return false;
+            } while (consume(','));
+            return consume(']');
+        }
+
+        bool parseHex(uint32_t& codePoint)
+        {
+            if (m_End - m_Position < 4) return false;
+            auto result = std::from_chars(m_Position, m_Position + 4, codePoint, 16);
+            if (result.ptr != m_Position + 4) return false;
+            m_Position += 4;
+            return true;
+        }
+
+        static void appendUTF8(std::string& text, uint32_t codePoint)
+        {
+            if (codePoint < 0x80) text += (char) codePoint;
+            else if (codePoint < 0x800)
+            {
+                text += (char) (0xC0 | (codePoint >> 6));
+                text += (char) (0x80 | (codePoint & 0x3F));
+            }
+            else if (codePoint < 0x10000)
+            {
+                text += (char) (0xE0 | (codePoint >> 12));
+                text += (char) (0x80 | ((codePoint >> 6) & 0x3F));
+                text += (char) (0x80 | (codePoint & 0x3F));
+            }
+            else
+            {
+                text += (char) (0xF0 | (codePoint >> 18));
+                text += (char) (0x80 | ((codePoint >> 12) & 0x3F));
+                text += (char) (0x80 | ((codePoint >> 6) & 0x3F));
+                text += (char) (0x80 | (codePoint & 0x3F));
+            }
+        }
+
+        bool parseString(std::string& text)
+        {
+            m_Position++;
+            while (m_Position < m_End)
+            {
+                char c = *m_Position++;
+                if (c == '"') return true;
+                if (c != '\\')
+                {
+                    text += c;
+                    continue;
+                }
+
+                if (m_Position == m_End) return false;
+                switch (char escape = *m_Position++)
+                {
+                    case 'b': text += '\b'; break;
+                    case 'f': text += '\f'; break;
+                    case 'n': text += '\n'; break;
+                    case 'r': text += '\r'; break;
+                    case 't': text += '\t'; break;
+                    case 'u':
+                    {
+                        uint32_t codePoint;
+                        if (!parseHex(codePoint)) return false;
+
+                        // Characters outside the BMP come as a surrogate pair
+                        uint32_t low;
+                        if (codePoint >= 0xD800 && codePoint < 0xDC00 && literal("\\u") && parseHex(low) &&
+                            low >= 0xDC00 && low < 0xE000)
+                            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        appendUTF8(text, codePoint);
+                        break;
+                    }
+                    default: text += escape; break;     // \" \\ \/
+                }
+            }
+            return false;
+        }
+    };
+
+    // --- GLB ---
+
+    constexpr uint32_t glbMagic = 0x46546C67;       // "glTF"
+    constexpr uint32_t jsonChunk = 0x4E4F534A;      // "JSON"
+    constexpr uint32_t binaryChunk = 0x004E4942;    // "BIN\0"
+
+    uint32_t readWord(const unsigned char* data)
+    {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    uint16_t readHalfWord(const unsigned char* data)
+    {
+        uint16_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    // Where an accessor's elements are in the binary chunk
+    struct AccessorData
+    {
+        const unsigned char* data = nullptr;    // First element
+        size_t count = 0;
+        unsigned int stride = 0;                // Bytes from one element to the next
+        unsigned int elementSize = 0;
+        GLenum type = GL_FLOAT;                 // glTF component types are GL enums
+        int components = 0;
+        bool normalized = false;
+        int bufferView = -1;
+    };
+
+    class GlbFile
+    {
+    public:
+        JsonValue json;
+        const unsigned char* binary = nullptr;
+        size_t binarySize = 0;
+        const char* path = nullptr;
+
+        bool resolveAccessor(const JsonValue& index, AccessorData& accessor) const
+        {
+            const JsonValue& description = json["accessors"][index.getSize(SIZE_MAX)];
+            const JsonValue& view = json["bufferViews"][description["bufferView"].getSize(SIZE_MAX)];
+            if (description.isNull() || view.isNull())
+            {
+                std::cout << path << ": accessor without a buffer view is not supported\n";
+                return false;
+            }
+            if (!description["sparse"].isNull())
+            {
+                std::cout << path << ": sparse accessors are not supported\n";
+                return false;
+            }
+
+            // Only the GLB's own binary chunk: buffer 0 without a uri
+            if (view["buffer"].getInt(-1) != 0 || !json["buffers"][0]["uri"].isNull() || binary == nullptr)
+            {
+                std::cout << path << ": only data in the GLB binary chunk is supported\n";
+                return false;
+            }
+
+            static const std::pair<std::string_view, int> types[] = {
+                    {"SCALAR", 1}, {"VEC2", 2}, {"VEC3", 3}, {"VEC4", 4}
+            };
+            for (const auto& [name, components] : types)
+                if (description["type"].string == name) accessor.components = components;
+
+            accessor.type = (GLenum) description["componentType"].getInt(0);
+            accessor.normalized = description["normalized"].boolean;
+            accessor.count = description["count"].getSize(0);
+            accessor.bufferView = description["bufferView"].getInt(-1);
+
+            bool knownType = accessor.type >= GL_BYTE && accessor.type <= GL_FLOAT && accessor.type != GL_INT;
+            if (accessor.components == 0 || !knownType || accessor.count == 0)
+            {
+                std::cout << path << ": unsupported accessor type\n";
+                return false;
+            }
+
+            accessor.elementSize = VertexLayout::getAttributeSize(accessor.components, accessor.type);
+            // glTF limits byteStride to 252
+            size_t stride = view["byteStride"].getSize(accessor.elementSize);
+            if (stride < accessor.elementSize || stride > 252)
+            {
+                std::cout << path << ": invalid buffer view stride\n";
+                return false;
+            }
+            accessor.stride = (unsigned int) stride;
+
+            // Every value is untrusted, so subtract from known sizes instead of adding up products that could wrap
+            size_t viewOffset = view["byteOffset"].getSize(0), viewLength = view["byteLength"].getSize(SIZE_MAX);
+            size_t offset = description["byteOffset"].getSize(0);
+            bool inView = viewOffset <= binarySize && viewLength <= binarySize - viewOffset && offset <= viewLength &&
+                          accessor.elementSize <= viewLength - offset &&
+                          accessor.count - 1 <= (viewLength - offset - accessor.elementSize) / accessor.stride;
+            if (!inView)
+            {
+                std::cout << path << ": accessor runs past its buffer view\n";
+                return false;
+            }
+
+            accessor.data = binary + viewOffset + offset;
+            return true;
+        }
+    };
+
+    bool openGLB(const char* path, const MappedFile& file, GlbFile& glb)
+    {
+        const unsigned char* data = file.data();
+        size_t size = file.size();
+        if (size < 20 || readWord(data) != glbMagic || readWord(data + 4) != 2 || readWord(data + 8) > size)
+        {
+            std::cout << path << " is not a glTF 2.0 binary file\n";
+            return false;
+        }
+        size = readWord(data + 8);
+
+        // Chunks: JSON first, then an optional binary chunk
+        size_t jsonLength = readWord(data + 12);
+        if (readWord(data + 16) != jsonChunk || 20 + jsonLength > size)
+        {
+            std::cout << path << ": missing JSON chunk\n";
+            return false;
+        }
+
+        auto text = (const char*) data + 20;
+        if (!JsonParser(text, text + jsonLength).parse(glb.json))
+        {
+            std::cout << path << ": malformed JSON chunk\n";
+            return false;
+        }
+
+        size_t binaryHeader = 20 + ((jsonLength + 3) & ~(size_t) 3);
+        if (binaryHeader + 8 <= size && readWord(data + binaryHeader + 4) == binaryChunk)
+        {
+            glb.binary = data + binaryHeader + 8;
+            glb.binarySize = std::min<size_t>(readWord(data + binaryHeader), size - binaryHeader - 8);
+        }
+        glb.path = path;
+        return true;
+    }
+
+    bool loadPrimitive(const GlbFile& glb, const JsonValue& description, GltfPrimitive& primitive)
+    {
+        if (description["mode"].getInt(4) != 4)
+        {
+            std::cout << glb.path << ": skipping a primitive that is not a triangle list\n";
+            return false;
+        }
+
+        static const std::pair<std::string_view, VertexSemantic> semantics[] = {
+                {"POSITION", PositionAttribute}, {"NORMAL", NormalAttribute}, {"TEXCOORD_0", TexCoordAttribute},
+                {"COLOR_0", ColorAttribute}, {"TANGENT", TangentAttribute}
+        };
+
+        std::vector<std::pair<VertexSemantic, AccessorData>> attributes;
+        for (const auto& [name, semantic] : semantics)
+        {
+            const JsonValue& index = description["attributes"][name];
+            if (index.isNull()) continue;
+
+            AccessorData accessor;
+            if (!glb.resolveAccessor(index, accessor)) return false;
+            attributes.emplace_back(semantic, accessor);
+        }
+
+        if (attributes.empty() || attributes[0].first != PositionAttribute)
+        {
+            std::cout << glb.path << ": skipping a primitive without positions\n";
+            return false;
+        }
+
+        size_t vertexCount = attributes[0].second.count;
+        for (const auto& [semantic, accessor] : attributes)
+        {
+            if (accessor.count != vertexCount)
+            {
+                std::cout << glb.path << ": attribute counts differ within a primitive\n";
+                return false;
+            }
+        }
+
+        // Zero copy when every attribute lies in one buffer view with one stride: that view already
+        // is an interleaved vertex buffer, and the VBO can be filled straight from the mapping
+        const AccessorData& first = attributes[0].second;
+        const unsigned char* base = first.data;
+        for (const auto& [semantic, accessor] : attributes) base = std::min(base, accessor.data);
+
+        VertexLayout layout;
+        bool shared = true;
+        for (const auto& [semantic, accessor] : attributes)
+        {
+            auto offset = (unsigned int) (accessor.data - base);
+            shared = shared && accessor.bufferView == first.bufferView && accessor.stride == first.stride &&
+                     offset + accessor.elementSize <= first.stride;
+            layout.add(semantic, accessor.components, accessor.type, accessor.normalized, offset);
+        }
+        layout.setStride(first.stride);
+
+        // Mesh uploads stride * count bytes, which may reach past the last element's own bytes
+        shared = shared && layout.getStride() == first.stride &&
+                 base + (size_t) first.stride * vertexCount <= glb.binary + glb.binarySize;
+
+        std::vector<unsigned char> staging;
+        const void* vertices = base;
+        if (!shared)
+        {
+            // Interleave once, keeping every component type
+            layout = VertexLayout();
+            for (const auto& [semantic, accessor] : attributes)
+                layout.add(semantic, accessor.components, accessor.type, accessor.normalized);
+
+            staging.resize((size_t) layout.getStride() * vertexCount);
+            for (size_t i = 0; i < attributes.size(); i++)
+            {
+                const AccessorData& accessor = attributes[i].second;
+                unsigned char* destination = staging.data() + layout.getAttributes()[i].offset;
+                for (size_t vertex = 0; vertex < vertexCount; vertex++)
+                    std::memcpy(destination + vertex * layout.getStride(), accessor.data + vertex * accessor.stride,
+                                accessor.elementSize);
+            }
+            vertices = staging.data();
+        }
+
+        primitive.mesh = std::make_shared<Mesh>();
+        primitive.material = description["material"].getInt(-1);
+        primitive.zeroCopy = shared;
+
+        // Unindexed primitives draw their vertices in order
+        const JsonValue& indexAccessor = description["indices"];
+        if (indexAccessor.isNull())
+        {
+            std::vector<unsigned int> indices(vertexCount);
+            std::iota(indices.begin(), indices.end(), 0u);
+            primitive.mesh->create(vertices, (unsigned int) vertexCount, indices.data(), (unsigned int) vertexCount,
+                                   layout);
+            return true;
+        }
+
+        AccessorData indices;
+        if (!glb.resolveAccessor(indexAccessor, indices)) return false;
+        bool validType = indices.type == GL_UNSIGNED_BYTE || indices.type == GL_UNSIGNED_SHORT ||
+                         indices.type == GL_UNSIGNED_INT;
+        if (!validType || indices.components != 1 || indices.stride != indices.elementSize)
+        {
+            std::cout << glb.path << ": unsupported index accessor\n";
+            return false;
+        }
+
+        // The GPU would read out of bounds otherwise; scanning the mapping is far cheaper than copying it
+        size_t maxIndex = 0;
+        for (size_t i = 0; i < indices.count; i++)
+        {
+            const unsigned char* index = indices.data + i * indices.elementSize;
+            size_t value = indices.elementSize == 1 ? *index :
+                           indices.elementSize == 2 ? (size_t) readHalfWord(index) : (size_t) readWord(index);
+            maxIndex = std::max(maxIndex, value);
+        }
+        if (maxIndex >= vertexCount)
+        {
+            std::cout << glb.path << ": index " << maxIndex << " is past the primitive's " << vertexCount << " vertices\n";
+            return false;
+        }
+
+        primitive.mesh->create(vertices, (unsigned int) vertexCount, indices.data, indices.type,
+                               (unsigned int) indices.count, layout);
+        return true;
+    }
+
+    glm::mat4 nodeTransform(const JsonValue& node)
+    {
+        const JsonValue& matrix = node["matrix"];
+        if (matrix.size() == 16)
+        {
+            float values[16];
+            for (size_t i = 0; i < 16; i++) values[i] = (float) matrix[i].getNumber(0.0);
+            return glm::make_mat4(values);      // Both are column-major
+        }
+
+        const JsonValue& t = node["translation"];
+        const JsonValue& r = node["rotation"];
+        const JsonValue& s = node["scale"];
+        glm::vec3 translation((float) t[0].getNumber(0.0), (float) t[1].getNumber(0.0), (float) t[2].getNumber(0.0));
+        glm::quat rotation((float) r[3].getNumber(1.0), (float) r[0].getNumber(0.0), (float) r[1].getNumber(0.0),
+                           (float) r[2].getNumber(0.0));
+        glm::vec3 scale((float) s[0].getNumber(1.0), (float) s[1].getNumber(1.0), (float) s[2].getNumber(1.0));
+
+        // T * R * S
+        return glm::scale(glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation), scale);
+    }
+
+    void addInstances(const JsonValue& nodes, size_t node, const glm::mat4& parent, int depth,
+                      std::vector<bool>& visited, GltfModel& model)
+    {
+        // Node graphs must be trees: skipping nodes seen before stops cycles and shared children
+        // (which could fan out exponentially) in malformed files, and the depth limit bounds the recursion
+        const JsonValue& description = nodes[node];
+        if (description.isNull() || visited[node] || depth > 64) return;
+        visited[node] = true;
+
+        glm::mat4 transform = parent * nodeTransform(description);
+        size_t mesh = description["mesh"].getSize(SIZE_MAX);
+        if (mesh < model.meshes.size()) model.instances.push_back({ (unsigned int) mesh, transform });
+
+        const JsonValue& children = description["children"];
+        for (size_t child = 0; child < children.size(); child++)
+            addInstances(nodes, children[child].getSize(SIZE_MAX), transform, depth + 1, visited, model);
+    }
+}
+
+bool GltfLoader::loadGLB(const char* path, GltfModel& model)
+{
+    TRACE_SCOPE("GltfLoader::loadGLB");
+
+    // Buffer views are read in whatever order the meshes reference them
+    MappedFile file;
+    if (!file.open(path, false)) return false;
+
+    GlbFile glb;
+    if (!openGLB(path, file, glb)) return false;
+
+    const JsonValue& meshes = glb.json["meshes"];
+    model.meshes.resize(meshes.size());
+    size_t loaded = 0;
+    for (size_t mesh = 0; mesh < meshes.size(); mesh++)
+    {
+        model.meshes[mesh].name = meshes[mesh]["name"].string;
+
+        const JsonValue& primitives = meshes[mesh]["primitives"];
+        for (size_t i = 0; i < primitives.size(); i++)
+        {
+            GltfPrimitive primitive;
+            if (!loadPrimitive(glb, primitives[i], primitive)) continue;
+            model.meshes[mesh].primitives.push_back(primitive);
+            loaded++;
+        }
+    }
+
+    if (loaded == 0)
+    {
+        std::cout << path << ": no loadable triangle meshes\n";
+        return false;
+    }
+
+    // Place meshes through the default scene; without scenes, every node that isn't a child is a root
+    const JsonValue& nodes = glb.json["nodes"];
+    const JsonValue& scene = glb.json["scenes"][glb.json["scene"].getSize(0)];
+    std::vector<size_t> roots;
+    if (!scene.isNull())
+    {
+        for (size_t i = 0; i < scene["nodes"].size(); i++) roots.push_back(scene["nodes"][i].getSize(SIZE_MAX));
+    }
+    else
+    {
+        std::vector<bool> child(nodes.size(), false);
+        for (size_t node = 0; node < nodes.size(); node++)
+            for (size_t i = 0; i < nodes[node]["children"].size(); i++)
+            {
+                size_t index = nodes[node]["children"][i].getSize(SIZE_MAX);
+                if (index < child.size()) child[index] = true;
+            }
+        for (size_t node = 0; node < nodes.size(); node++)
+            if (!child[node]) roots.push_back(node);
+    }
+
+    std::vector<bool> visited(nodes.size(), false);
+    for (size_t root : roots) addInstances(nodes, root, glm::mat4(1.0f), 0, visited, model);
+
+    // A file without nodes still shows its meshes
+    if (nodes.size() == 0)
+        for (size_t mesh = 0; mesh < model.meshes.size(); mesh++)
+            model.instances.push_back({ (unsigned int) mesh, glm::mat4(1.0f) });
+    return true;
+}
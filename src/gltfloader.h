@@ -0,0 +1,58 @@
+//
+// glTF 2.0 binary (.glb) loading
+//
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+struct GltfPrimitive
+{
+    std::shared_ptr<Mesh> mesh;
+    int material = -1;          // Index into the file's materials, or -1
+    bool zeroCopy = false;      // Vertices went straight from the mapped file into the VBO, without staging
+};
+
+struct GltfMesh
+{
+    std::string name;
+    std::vector<GltfPrimitive> primitives;
+};
+
+// One placement of a mesh in the scene
+struct GltfInstance
+{
+    unsigned int mesh;
+    glm::mat4 transform;        // Node's world transform
+};
+
+struct GltfModel
+{
+    std::vector<GltfMesh> meshes;
+    std::vector<GltfInstance> instances;    // Every mesh node of the default scene (or of all root nodes)
+};
+
+/* Loads the meshes of a binary glTF 2.0 file. The file is memory-mapped and its JSON chunk parsed
+ * with a small built-in parser; each triangle primitive becomes one Mesh.
+ *
+ * Accessors are not converted: attributes keep their component types (so quantized files stay
+ * quantized), with POSITION, NORMAL, TEXCOORD_0, COLOR_0 and TANGENT at the VertexSemantic
+ * locations. When every attribute of a primitive sits in one buffer view (interleaved, or a single
+ * tightly packed attribute), the VBO is filled straight from the mapping. Otherwise the attributes
+ * are interleaved once into a staging buffer. Indices of any type glTF allows are uploaded from the
+ * mapping as they are (see Mesh::create with an index type).
+ *
+ * Only the embedded binary buffer is supported; external and data: URIs, sparse accessors and
+ * non-triangle primitives are reported and skipped.
+ */
+class GltfLoader
+{
+public:
+    GltfLoader() = delete;
+
+    static bool loadGLB(const char* path, GltfModel& model);
+};
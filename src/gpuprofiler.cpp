@@ -0,0 +1,146 @@
+//
+// GPU timer queries grouped into named zones
+//
+
+#include "gpuprofiler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <GL/glew.h>
+
+GPUProfiler::~GPUProfiler()
+{
+    for (Frame& frame : m_Frames)
+    {
+        for (TimerQuery& query : frame.queries)
+        {
+            glDeleteQueries(1, &query.begin);
+            glDeleteQueries(1, &query.end);
+        }
+    }
+}
+
+void GPUProfiler::beginFrame()
+{
+    // The slot about to be reused holds the oldest frame, which the GPU has most likely finished
+    m_Frame = (m_Frame + 1) % frameLatency;
+    collect(m_Frames[m_Frame]);
+
+    m_Open.clear();
+    m_InFrame = true;
+}
+
+void GPUProfiler::endFrame()
+{
+    // Close any zone left open so its queries still pair up
+    while (!m_Open.empty()) end();
+    m_InFrame = false;
+}
+
+void GPUProfiler::begin(const char* zone)
+{
+    if (!m_InFrame) return;
+
+    auto found = m_ZoneIndices.find(zone);
+    int zoneIndex;
+    if (found == m_ZoneIndices.end())
+    {
+        zoneIndex = (int) m_Zones.size();
+        m_ZoneIndices.emplace(zone, zoneIndex);
+        m_Zones.push_back({ zone, {}, 0, 0.0 });
+    }
+    else
+    {
+        zoneIndex = found->second;
+    }
+
+    // Query objects are created on first use and recycled every frameLatency frames
+    Frame& frame = m_Frames[m_Frame];
+    if (frame.used == frame.queries.size())
+    {
+        TimerQuery query {};
+        glGenQueries(1, &query.begin);
+        glGenQueries(1, &query.end);
+        frame.queries.push_back(query);
+    }
+
+    TimerQuery& query = frame.queries[frame.used];
+    query.zone = zoneIndex;
+    glQueryCounter(query.begin, GL_TIMESTAMP);
+
+    m_Open.push_back(frame.used++);
+}
+
+void GPUProfiler::end()
+{
+    if (m_Open.empty()) return;
+
+    glQueryCounter(m_Frames[m_Frame].queries[m_Open.back()].end, GL_TIMESTAMP);
+    m_Open.pop_back();
+}
+
+void GPUProfiler::collect(Frame& frame)
+{
+    for (size_t i = 0; i < frame.used; i++)
+    {
+        TimerQuery& query = frame.queries[i];
+
+        // Never wait: a result that isn't ready yet is dropped rather than stalling the CPU
+        int available = 0;
+        glGetQueryObjectiv(query.end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            m_Dropped++;
+            continue;
+        }
+
+        uint64_t beginTime = 0, endTime = 0;
+        glGetQueryObjectui64v(query.begin, GL_QUERY_RESULT, &beginTime);
+        glGetQueryObjectui64v(query.end, GL_QUERY_RESULT, &endTime);
+
+        Zone& zone = m_Zones[query.zone];
+        zone.last = (double) (endTime - beginTime) / 1.0e6;
+        if (zone.history.size() < historySize) zone.history.push_back(zone.last);
+        else zone.history[zone.next] = zone.last;
+        zone.next = (zone.next + 1) % historySize;
+    }
+
+    frame.used = 0;
+}
+
+std::vector<GPUProfiler::ZoneResult> GPUProfiler::getResults() const
+{
+    std::vector<ZoneResult> results;
+    for (const Zone& zone : m_Zones)
+    {
+        ZoneResult result { zone.name, zone.last, 0.0, 0.0, 0.0, zone.history.size() };
+        if (!zone.history.empty())
+        {
+            std::vector<double> sorted = zone.history;
+            std::sort(sorted.begin(), sorted.end());
+
+            result.min = sorted.front();
+            for (double sample : sorted) result.average += sample;
+            result.average /= (double) sorted.size();
+            result.p99 = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+        }
+        results.push_back(result);
+    }
+    return results;
+}
+
+void GPUProfiler::dump(std::ostream& out) const
+{
+    out << "GPU zone            last ms    min ms    avg ms    p99 ms  samples\n";
+    for (const ZoneResult& result : getResults())
+    {
+        out << std::left << std::setw(16) << result.name << std::right << std::fixed << std::setprecision(3)
+            << std::setw(10) << result.last
+            << std::setw(10) << result.min
+            << std::setw(10) << result.average
+            << std::setw(10) << result.p99
+            << std::setw(9) << result.samples << '\n';
+    }
+    if (m_Dropped != 0) out << m_Dropped << " results dropped (not ready in time)\n";
+}
@@ -0,0 +1,89 @@
+//
+// GPU timer queries grouped into named zones
+//
+
+#pragma once
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Measures GPU time per named zone with GL_TIMESTAMP queries (timestamps, unlike GL_TIME_ELAPSED,
+ * allow zones to nest). Queries are kept in a ring of frames and only read back once they are
+ * frameLatency frames old, so collecting results never stalls the pipeline.
+ *
+ *     profiler.beginFrame();
+ *     {
+ *         GPUProfiler::Scope scope(profiler, "draw");
+ *         ...
+ *     }
+ *     profiler.endFrame();
+ */
+class GPUProfiler
+{
+public:
+    GPUProfiler() = default;
+    ~GPUProfiler();
+
+    class Scope
+    {
+    public:
+        Scope(GPUProfiler& profiler, const char* zone) : m_Profiler(profiler) { m_Profiler.begin(zone); }
+        ~Scope() { m_Profiler.end(); }
+    private:
+        GPUProfiler& m_Profiler;
+    };
+
+    struct ZoneResult
+    {
+        std::string name;
+        double last, min, average, p99;     // Milliseconds
+        size_t samples;
+    };
+private:
+    static constexpr int frameLatency = 4;
+    static constexpr size_t historySize = 256;
+
+    struct TimerQuery
+    {
+        unsigned int begin, end;
+        int zone;
+    };
+
+    struct Frame
+    {
+        std::vector<TimerQuery> queries;
+        size_t used = 0;
+    };
+
+    struct Zone
+    {
+        std::string name;
+        std::vector<double> history;    // Ring of the last historySize samples
+        size_t next = 0;
+        double last = 0.0;
+    };
+
+    Frame m_Frames[frameLatency];
+    int m_Frame = 0;
+    bool m_InFrame = false;
+    std::vector<size_t> m_Open;
+
+    std::vector<Zone> m_Zones;
+    std::unordered_map<std::string, int> m_ZoneIndices;
+    unsigned long long m_Dropped = 0;
+private:
+    void collect(Frame& frame);
+public:
+    void beginFrame();
+    void endFrame();
+
+    void begin(const char* zone);
+    void end();
+
+    std::vector<ZoneResult> getResults() const;
+    void dump(std::ostream& out) const;
+
+    // Results that were still not available after frameLatency frames and were discarded
+    constexpr unsigned long long getDroppedCount() const { return m_Dropped; }
+};
@@ -0,0 +1,65 @@
+//
+// RGBA8 images and PNG files
+//
+
+#include "image.h"
+
+#include <iostream>
+#include <cstring>
+#include <png.h>
+
+void Image::resize(unsigned int newWidth, unsigned int newHeight)
+{
+    width = newWidth;
+    height = newHeight;
+    pixels.assign((size_t) width * height * 4, 0);
+}
+
+void Image::setFromFramebuffer(const unsigned char* rows, unsigned int newWidth, unsigned int newHeight)
+{
+    resize(newWidth, newHeight);
+
+    size_t rowSize = (size_t) width * 4;
+    for (unsigned int y = 0; y < height; y++)
+        std::memcpy(pixels.data() + rowSize * y, rows + rowSize * (height - 1 - y), rowSize);
+}
+
+bool Image::loadPNG(const char* path)
+{
+    // The simplified libpng API converts any bit depth/colour type to RGBA8 for us
+    png_image image {};
+    image.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&image, path))
+    {
+        std::cout << "Could not read " << path << ": " << image.message << '\n';
+        return false;
+    }
+
+    image.format = PNG_FORMAT_RGBA;
+    resize(image.width, image.height);
+    if (!png_image_finish_read(&image, nullptr, pixels.data(), 0, nullptr))
+    {
+        std::cout << "Could not decode " << path << ": " << image.message << '\n';
+        png_image_free(&image);
+        return false;
+    }
+
+    return true;
+}
+
+bool Image::savePNG(const char* path) const
+{
+    png_image image {};
+    image.version = PNG_IMAGE_VERSION;
+    image.width = width;
+    image.height = height;
+    image.format = PNG_FORMAT_RGBA;
+
+    if (!png_image_write_to_file(&image, path, 0, pixels.data(), 0, nullptr))
+    {
+        std::cout << "Could not write " << path << ": " << image.message << '\n';
+        return false;
+    }
+
+    return true;
+}
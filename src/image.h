@@ -0,0 +1,21 @@
+//
+// RGBA8 images and PNG files
+//
+
+#pragma once
+#include <vector>
+
+// Tightly packed RGBA8 pixels, top row first (the order PNG stores them in, not GL's)
+struct Image
+{
+    unsigned int width = 0, height = 0;
+    std::vector<unsigned char> pixels;
+
+    void resize(unsigned int newWidth, unsigned int newHeight);
+
+    // Copies bottom-up rows as read back from GL, flipping them into top-down order
+    void setFromFramebuffer(const unsigned char* rows, unsigned int newWidth, unsigned int newHeight);
+
+    bool loadPNG(const char* path);
+    bool savePNG(const char* path) const;
+};
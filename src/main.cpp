@@ -7,8 +7,10 @@
 #include <complex>
 #include <vector>
 #include <cstring>
-#include <thread>
 #include <random>
+#include <string>
+#include <algorithm>
+#include <cctype>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -19,25 +21,139 @@
 #include "window.h"
 #include "mesh.h"
 #include "shader.h"
+#include "scheduler.h"
+#include "statecache.h"
+#include "renderqueue.h"
+#include "shadercompiler.h"
+#include "shaderlibrary.h"
+#include "uniformbuffer.h"
+#include "gpuprofiler.h"
+#include "trace.h"
+#include "capture.h"
+#include "modelloader.h"
+#include "gltfloader.h"
 
 namespace
 {
-    unsigned int uniformProjection = 0, uniformModel = 0;
     std::vector<std::shared_ptr<Mesh>> meshes;
+    std::vector<glm::mat4> meshTransforms;      // Placement of each mesh within the model
     std::vector<std::shared_ptr<Shader>> shaders;
 
-    // Shader stuff
-    const char* vertexShader = "/home/msullivan/Projects/CLion/OpenGLPractice7/src/Shaders/shader.vertex";
-    const char* fragmentShader = "/home/msullivan/Projects/CLion/OpenGLPractice7/src/Shaders/shader.fragment";
+    // Shader stuff (SHADER_DIR is set by CMake so the binary runs from any working directory)
+    const char* vertexShader = SHADER_DIR "shader.vertex";
+    const char* fragmentShader = SHADER_DIR "shader.fragment";
+
+    // Drawn with while the real programs are still compiling; small enough to link instantly
+    std::shared_ptr<Shader> fallbackShader;
+    const char* fallbackVertexSource = R"(#version 330
+layout (location = 0) in vec3 pos;
+layout (std140) uniform FrameData { mat4 view; mat4 projection; vec4 time; };
+layout (std140) uniform ObjectData { mat4 model; };
+out vec4 vertexColor;
+void main()
+{
+    gl_Position = projection * view * model * vec4(pos, 1.0);
+    vertexColor = vec4(0.5, 0.5, 0.5, 1.0);
+})";
+    const char* fallbackFragmentSource = R"(#version 330
+in vec4 vertexColor;
+out vec4 color;
+void main()
+{
+    color = vertexColor;
+})";
 }
 
-// Uniform variables
-bool direction = true;
-float triOffset = 0.0f, triMaxOffset = 1.0f, triTranslationIncrement = 0.015f;
-float currentAngle = 0.0f;
+// Animation rates are per second so they don't depend on the frame rate
+float triMaxOffset = 1.0f, triTranslationSpeed = 0.9f, modelDriftSpeed = 6.0f;
+float colorSpeed = 0.9f, angleSpeed = 3.0f;
+
+// Everything the simulation advances each fixed step
+struct SceneState
+{
+    bool direction = true;
+    float triOffset = 0.0f;
+    float modelOffset = 0.0f;
+    float currentAngle = 0.0f;
+    float colorPhase = 0.0f;
+};
+
+void updateScene(SceneState& state, float dt)
+{
+    if (state.direction)
+    {
+        state.triOffset += triTranslationSpeed * dt;
+    }
+    else
+    {
+        state.triOffset -= triTranslationSpeed * dt;
+    }
+
+    if (std::abs(state.triOffset) >= triMaxOffset)
+    {
+        state.direction = !state.direction;
+    }
+
+    // The model drifts by a fraction of the current offset, so its position keeps accumulating
+    state.modelOffset += state.triOffset * modelDriftSpeed * dt;
+
+    state.currentAngle += angleSpeed * dt;
+    if (state.currentAngle >= 360)
+    {
+        state.currentAngle -= 360;
+    }
+
+    state.colorPhase += colorSpeed * dt;
+}
 
-void createObjects()
+bool createObjects(const char* modelPath)
 {
+    // Same extension matching as ModelLoader::load, which handles everything but .glb
+    std::string extension = modelPath != nullptr ? modelPath : "";
+    extension = extension.substr(std::min(extension.rfind('.'), extension.size()));
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (extension == ".glb")
+    {
+        GltfModel model;
+        if (!GltfLoader::loadGLB(modelPath, model)) return false;
+
+        // One mesh per primitive of every placed glTF mesh
+        for (const GltfInstance& instance : model.instances)
+        {
+            for (const GltfPrimitive& primitive : model.meshes[instance.mesh].primitives)
+            {
+                meshes.emplace_back(primitive.mesh);
+                meshTransforms.push_back(instance.transform);
+            }
+        }
+        std::cout << "Loaded " << modelPath << ": " << meshes.size() << " primitives\n";
+        return true;
+    }
+
+    if (modelPath != nullptr)
+    {
+        // Quantized positions land in [-1, 1], the same size as the tetrahedron below
+        ModelImportOptions options;
+        options.quantize = true;
+
+        ImportedModel model;
+        if (!ModelLoader::import(modelPath, model, options)) return false;
+        std::cout << "Loaded " << modelPath << ": " << model.vertexCount << " vertices, "
+                  << model.indexCount / 3 << " triangles";
+        if (options.optimize)
+        {
+            std::streamsize precision = std::cout.precision(2);
+            std::cout << std::fixed << ", vertex cache ACMR " << model.cacheBefore.acmr << " -> "
+                      << model.cacheAfter.acmr << ", ATVR " << model.cacheBefore.atvr << " -> "
+                      << model.cacheAfter.atvr << std::defaultfloat;
+            std::cout.precision(precision);
+        }
+        std::cout << '\n';
+        meshes.emplace_back(model.mesh);
+        meshTransforms.emplace_back(1.0f);
+        return true;
+    }
+
     unsigned int indices[] = {
             0, 3, 1,
             1, 3, 2,
@@ -56,65 +172,153 @@ void createObjects()
     std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
     mesh->create(vertices, indices, 12, 12);
     meshes.emplace_back(mesh);
+    meshTransforms.emplace_back(1.0f);
+    return true;
 }
 
-void createShaders()
+void createShaders(ShaderLibrary& library)
 {
-    std::shared_ptr<Shader> shader = std::make_shared<Shader>();
-    shader->createFromFiles(vertexShader, fragmentShader);
-    shaders.emplace_back(shader);
+    fallbackShader = std::make_shared<Shader>();
+    fallbackShader->createFromStrings(fallbackVertexSource, fallbackFragmentSource);
+
+    // Compiles in the background and reloads whenever the files change on disk
+    shaders.emplace_back(library.load("basic", vertexShader, fragmentShader));
 }
 
-int main()
+int main(int argc, char** argv)
 {
-    // Initialize GLFW
-    if (!glfwInit())
+    // Command-line options: --headless renders offscreen, --frames N stops after N frames,
+    // --pacing picks how frames are paced (defaults to vsync on screen, uncapped headless),
+    // --profile prints GPU zone timings on exit, --trace writes a Chrome trace of CPU scopes on exit,
+    // --capture path saves every frame (a directory of PNGs, or a .y4m file with --capture-format y4m),
+    // --model file.obj|file.ply|file.glb draws that model instead of the tetrahedron
+    bool headless = false, profile = false;
+    unsigned int frameLimit = 0;
+    const char* pacing = nullptr;
+    const char* tracePath = nullptr;
+    const char* capturePath = nullptr;
+    const char* captureFormat = "png";
+    const char* modelPath = nullptr;
+    for (int arg = 1; arg < argc; arg++)
     {
-        std::cout << "GLFW failed to initialize\n";
-
-        // Unload GLFW memory
-        glfwTerminate();
-        return 1;
+        if (strcmp(argv[arg], "--headless") == 0) headless = true;
+        else if (strcmp(argv[arg], "--frames") == 0 && arg + 1 < argc) frameLimit = std::strtoul(argv[++arg], nullptr, 10);
+        else if (strcmp(argv[arg], "--pacing") == 0 && arg + 1 < argc) pacing = argv[++arg];
+        else if (strcmp(argv[arg], "--profile") == 0) profile = true;
+        else if (strcmp(argv[arg], "--trace") == 0 && arg + 1 < argc) tracePath = argv[++arg];
+        else if (strcmp(argv[arg], "--capture") == 0 && arg + 1 < argc) capturePath = argv[++arg];
+        else if (strcmp(argv[arg], "--capture-format") == 0 && arg + 1 < argc) captureFormat = argv[++arg];
+        else if (strcmp(argv[arg], "--model") == 0 && arg + 1 < argc) modelPath = argv[++arg];
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--headless] [--frames N] [--pacing vsync|busywait|uncapped]"
+                      << " [--profile] [--trace file.json] [--capture path] [--capture-format png|y4m]"
+                      << " [--model file.obj|file.ply|file.glb]\n";
+            return 1;
+        }
     }
 
-    GLWindow window(800, 600);
-    window.init();
+    CpuTrace::setEnabled(tracePath != nullptr);
 
-    // Allow modern extension features
-    glewExperimental = true;
-
-    // Setup GLEW
-    if (glewInit() == GLEW_OK)
+    PacingMode pacingMode = headless ? PacingMode::Uncapped : PacingMode::VSync;
+    if (pacing != nullptr)
     {
-        std::cout << "Could not initialize GLEW\n";
-        glfwTerminate();
-        return 1;
+        if (strcmp(pacing, "vsync") == 0) pacingMode = PacingMode::VSync;
+        else if (strcmp(pacing, "busywait") == 0) pacingMode = PacingMode::BusyWait;
+        else if (strcmp(pacing, "uncapped") == 0) pacingMode = PacingMode::Uncapped;
+        else
+        {
+            std::cout << "Unknown pacing mode \"" << pacing << "\"\n";
+            return 1;
+        }
     }
 
+    GLWindow window(800, 600, headless ? WindowBackend::Headless : WindowBackend::GLFW);
+    window.setFrameLimit(frameLimit);
+
+    // Creates the context and sets up GLEW
+    if (window.init() != 0) return 1;
+
+    // Simulate at a fixed 60 Hz; busy-wait pacing also targets 60 frames per second
+    FrameScheduler scheduler(60.0, 60.0, pacingMode);
+    window.setVSync(pacingMode == PacingMode::VSync);
+
     // Used to prevent sides from being rendered incorrectly
-    glEnable(GL_DEPTH_TEST);
+    GLStateCache::enable(GL_DEPTH_TEST);
 
     // Setup viewport size
     glViewport(0, 0, window.getBufferWidth(), window.getBufferHeight());
 
-    createObjects();
-    createShaders();
+    if (!createObjects(modelPath)) return 1;
+    ShaderCompiler shaderCompiler;
+    ShaderLibrary shaderLibrary(shaderCompiler);
+    createShaders(shaderLibrary);
 
     glm::mat4 projection = glm::perspective(45.0f, window.getBufferHeight()/window.getBufferWidth(), 0.1f, 300.0f);
-    glm::mat4 model(1.0f);
+    glm::mat4 baseModel(1.0f);
+
+    baseModel = glm::scale(baseModel, glm::vec3(3.0f, 3.0f, 3.0f));
+    baseModel = glm::translate(baseModel, glm::vec3(-3.0f, 0.0f, -10.0f));
+
+    SceneState previous, current;
+    RenderQueue renderQueue;
+
+    // Per-frame block (camera, time) and room for 1024 per-object blocks a frame
+    UniformBuffer uniforms;
+    uniforms.create(1024);
+    FrameUniforms frameUniforms;
+    frameUniforms.projection = projection;
 
-    model = glm::scale(model, glm::vec3(3.0f, 3.0f, 3.0f));
-    model = glm::translate(model, glm::vec3(-3.0f, 0.0f, -10.0f));
+    GPUProfiler gpuProfiler;
 
+    FrameCapture frameCapture;
+    if (capturePath != nullptr)
+    {
+        if (strcmp(captureFormat, "png") != 0 && strcmp(captureFormat, "y4m") != 0)
+        {
+            std::cout << "Unknown capture format \"" << captureFormat << "\"\n";
+            return 1;
+        }
+
+        CaptureFormat format = strcmp(captureFormat, "y4m") == 0 ? CaptureFormat::Y4M : CaptureFormat::PNG;
+        if (!frameCapture.create((unsigned int) window.getBufferWidth(), (unsigned int) window.getBufferHeight(),
+                                 format, capturePath))
+            return 1;
+    }
 
     // Main loop
     while (!window.shouldClose())
     {
+        TRACE_SCOPE("frame");
+
         // Get/handle user input
-        glfwPollEvents();
+        window.pollEvents();
+
+        // Pick up any programs that finished compiling, then swap in reloaded ones
+        {
+            TRACE_SCOPE("shaders");
+            shaderCompiler.poll();
+            shaderLibrary.update();
+        }
+
+        gpuProfiler.beginFrame();
+        gpuProfiler.begin("frame");
 
+        scheduler.beginFrame();
+        while (scheduler.update())
         {
-            static float i = 0;
+            TRACE_SCOPE("update");
+            previous = current;
+            updateScene(current, (float) scheduler.getTimestep());
+        }
+
+        {
+            TRACE_SCOPE("render");
+
+            // Render between the last two simulated states
+            auto alpha = (float) scheduler.getAlpha();
+            float i = glm::mix(previous.colorPhase, current.colorPhase, alpha);
+            float modelOffset = glm::mix(previous.modelOffset, current.modelOffset, alpha);
 
 //            // Rotates between "hard" RGB values
 //            auto r = (float) std::sin(i+(2*M_PI/3));
@@ -126,48 +330,60 @@ int main()
             auto g = (float) std::abs(std::sin(i));
             auto b = (float) std::abs(std::sin(i-(2*M_PI/3)));
 
-            if (direction)
-            {
-                triOffset += triTranslationIncrement;
-            }
-            else
-            {
-                triOffset -= triTranslationIncrement;
-            }
-
-            if (std::abs(triOffset) >= triMaxOffset)
-            {
-                direction = !direction;
-            }
-
-            if (currentAngle >= 360)
-            {
-                currentAngle -= 360;
-            }
-
             // Clear window
+            gpuProfiler.begin("clear");
             glClearColor(r, g, b, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            gpuProfiler.end();
 
-            shaders[0]->use();
-            uniformProjection = shaders[0]->getProjectionLocation();
-            uniformModel = shaders[0]->getModelLocation();
+            glm::mat4 model = glm::translate(baseModel, glm::vec3(modelOffset, 0.0f, 0.0f));
 
-            model = glm::translate(model, glm::vec3(triOffset/10, 0.0f, -0.0f));
-            glUniformMatrix4fv((int) uniformModel, 1, false, glm::value_ptr(model));
-            glUniformMatrix4fv((int) uniformProjection, 1, false, glm::value_ptr(projection));
+            Shader* shader = shaders[0]->isReady() ? shaders[0].get() : fallbackShader.get();
 
-            for (const auto& mesh : meshes) mesh->render();
+            // The camera sits at the origin looking down -Z, so depth is the negated view-space Z
+            for (size_t index = 0; index < meshes.size(); index++)
+            {
+                DrawPacket packet;
+                packet.mesh = meshes[index].get();
+                packet.shader = shader;
+                packet.transform = model * meshTransforms[index];
+                packet.depth = -packet.transform[3].z;
+                renderQueue.submit(packet);
+            }
 
-            glUseProgram(0);
+            frameUniforms.time += glm::vec4((float) scheduler.getFrameTime(), 0.0f, 1.0f, 0.0f);
+            frameUniforms.time.y = (float) scheduler.getFrameTime();
+            uniforms.setFrame(frameUniforms);
 
-            std::this_thread::sleep_for(std::chrono::microseconds(16667));
-            i += 0.015f;
-            currentAngle += 0.05f;
+            GPUProfiler::Scope drawScope(gpuProfiler, "draw");
+            renderQueue.dispatch(uniforms);
+            renderQueue.clear();
+            uniforms.endFrame();
         }
 
-        // Swap display buffers
+        // Wait out the rest of the frame (busy-wait pacing only), then swap display buffers
+        {
+            TRACE_SCOPE("pacing");
+            scheduler.endFrame();
+        }
+        gpuProfiler.end();
+        gpuProfiler.endFrame();
+        frameCapture.capture();
         window.swapBuffers();
     }
+
+    if (frameCapture.isActive())
+    {
+        frameCapture.finish();
+        std::cout << "Captured " << frameCapture.getEncodedCount() << " frames";
+        if (frameCapture.getFailedCount() != 0) std::cout << " (" << frameCapture.getFailedCount() << " failed)";
+        std::cout << '\n';
+    }
+
+    if (profile) gpuProfiler.dump(std::cout);
+    if (tracePath != nullptr) CpuTrace::write(tracePath);
+
+    std::cout << "GL state changes: " << GLStateCache::getIssuedCount() << " issued, "
+              << GLStateCache::getElidedCount() << " elided\n";
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+//
+// Read-only memory-mapped files
+//
+
+#include "mappedfile.h"
+
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() : m_Data(nullptr), m_Size(0)
+{}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char* path, bool sequential)
+{
+    close();
+
+    int file = ::open(path, O_RDONLY);
+    if (file < 0)
+    {
+        std::cout << "Could not open " << path << '\n';
+        return false;
+    }
+
+    struct stat status {};
+    if (fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        std::cout << "Could not map " << path << ": file is empty or unreadable\n";
+        ::close(file);
+        return false;
+    }
+
+    void* data = mmap(nullptr, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+    // The mapping keeps the file alive on its own
+    ::close(file);
+    if (data == MAP_FAILED)
+    {
+        std::cout << "Could not map " << path << '\n';
+        return false;
+    }
+
+    if (sequential) madvise(data, (size_t) status.st_size, MADV_SEQUENTIAL);
+
+    m_Data = data;
+    m_Size = (size_t) status.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_Data != nullptr) munmap(m_Data, m_Size);
+    m_Data = nullptr;
+    m_Size = 0;
+}
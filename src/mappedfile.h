@@ -0,0 +1,30 @@
+//
+// Read-only memory-mapped files
+//
+
+#pragma once
+#include <cstddef>
+
+/* Maps a whole file read-only, so loaders parse straight out of the page cache instead of
+ * copying it into a buffer first, and pages are only read when something touches them.
+ */
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+private:
+    void* m_Data;
+    size_t m_Size;
+public:
+    // sequential hints the kernel to read ahead aggressively, for files parsed front to back
+    bool open(const char* path, bool sequential = true);
+    void close();
+
+    const unsigned char* data() const { return (const unsigned char*) m_Data; }
+    constexpr size_t size() const { return m_Size; }
+    constexpr bool isOpen() const { return m_Data != nullptr; }
+};
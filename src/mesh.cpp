@@ -3,8 +3,18 @@
 //
 
 #include "mesh.h"
+#include "statecache.h"
+#include "renderstats.h"
+#include "trace.h"
 
-Mesh::Mesh() : m_VAO(0), m_VBO(0), m_IBO(0), m_IndexCount(0)
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+bool Mesh::s_ByteIndices = false;
+
+Mesh::Mesh() : m_VAO(0), m_VBO(0), m_IBO(0), m_InstanceVBO(0), m_VertexBytes(0), m_IndexCount(0), m_InstanceCapacity(0),
+               m_VertexStride(0), m_IndexType(GL_UNSIGNED_INT), m_IndexSize(sizeof(unsigned int))
 {}
 
 Mesh::~Mesh()
@@ -14,66 +24,366 @@ Mesh::~Mesh()
 
 void Mesh::create(float* vertices, unsigned int* indices, unsigned int vertexCount, unsigned int indexCount)
 {
+    create(vertices, vertexCount / 3, indices, indexCount, VertexLayout::positions());
+}
+
+void Mesh::create(const void* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount,
+                  const VertexLayout& layout)
+{
+    TRACE_SCOPE("Mesh::create");
+
+    // Store indices in the narrowest type that fits, relative to their chunk's base vertex
+    chooseIndexFormat(indices, indexCount);
+    std::vector<unsigned char> packed((size_t) m_IndexSize * indexCount);
+    for (unsigned int i = 0; i < indexCount; i++) packIndex(i, indices[i], packed.data() + (size_t) m_IndexSize * i);
+
+    upload(vertices, vertexCount, packed.data(), indexCount, layout);
+}
+
+void Mesh::create(const void* vertices, unsigned int vertexCount, const void* indices, GLenum indexType,
+                  unsigned int indexCount, const VertexLayout& layout)
+{
+    TRACE_SCOPE("Mesh::create");
+
+    m_Chunks.assign(1, { 0, indexCount, 0 });
+    m_IndexType = indexType;
+    m_IndexSize = indexType == GL_UNSIGNED_BYTE ? 1 : indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+
+    // Widen 8-bit indices unless they are enabled, for the same reason chooseIndexFormat() avoids them
+    std::vector<unsigned short> widened;
+    if (indexType == GL_UNSIGNED_BYTE && !s_ByteIndices)
+    {
+        widened.assign((const unsigned char*) indices, (const unsigned char*) indices + indexCount);
+        indices = widened.data();
+        m_IndexType = GL_UNSIGNED_SHORT;
+        m_IndexSize = 2;
+    }
+
+    upload(vertices, vertexCount, indices, indexCount, layout);
+}
+
+void Mesh::upload(const void* vertices, unsigned int vertexCount, const void* indices, unsigned int indexCount,
+                  const VertexLayout& layout)
+{
+    m_VertexStride = layout.getStride();
+    m_VertexBytes = (size_t) m_VertexStride * vertexCount;
     m_IndexCount = indexCount;
 
     // Generate and bind VAO
     glGenVertexArrays(1, &m_VAO);
-    glBindVertexArray(m_VAO);
+    GLStateCache::bindVertexArray(m_VAO);
 
     // Generate, bind, and buffer index array
+    size_t indexBytes = (size_t) m_IndexSize * indexCount;
     glGenBuffers(1, &m_IBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indexCount, indices, GL_STATIC_DRAW);
+    GLStateCache::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr) indexBytes, indices, GL_STATIC_DRAW);
+    RenderStats::countUpload(indexBytes);
 
-    // Generate, bind, and buffer VBO
+    // Generate, bind, and buffer VBO; every attribute is interleaved in this one buffer
     glGenBuffers(1, &m_VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertexCount, vertices, GL_STATIC_DRAW);
+    GLStateCache::bindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) m_VertexBytes, vertices, GL_STATIC_DRAW);
+    RenderStats::countUpload(m_VertexBytes);
+
+    layout.apply();
+
+    // The VAO stays bound and keeps the IBO attached (the element buffer binding is VAO state)
+}
+
+void Mesh::chooseIndexFormat(const unsigned int* indices, unsigned int indexCount)
+{
+    unsigned int maxIndex = 0;
+    for (unsigned int i = 0; i < indexCount; i++) maxIndex = std::max(maxIndex, indices[i]);
+
+    m_Chunks.assign(1, { 0, indexCount, 0 });
+    if (maxIndex <= 0xFF && s_ByteIndices)
+    {
+        m_IndexType = GL_UNSIGNED_BYTE;
+        m_IndexSize = 1;
+        return;
+    }
 
-    /* index: Which vertex in buffer
-     * size: Number of elements in buffer
-     * type: Data type
-     * normalized: If 0.0-0.1, then it is already normalized; if 0-255, then it is NOT normalized (I think)
-     * stride: How many elements to skip
-     * pointer: Where to start
-     */
-    glVertexAttribPointer(0, 3, GL_FLOAT, false, 0, nullptr);
-    glEnableVertexAttribArray(0);
+    m_IndexType = GL_UNSIGNED_SHORT;
+    m_IndexSize = 2;
+    if (maxIndex <= 0xFFFF) return;
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    // Too many vertices for one 16-bit range: cut the triangle list wherever the span of
+    // referenced vertices would exceed it, and draw each piece from its lowest vertex
+    std::vector<IndexChunk> chunks;
+    unsigned int start = 0, lowest = 0, highest = 0;
+    bool chunked = indexCount % 3 == 0;
+    for (unsigned int i = 0; i < indexCount && chunked; i += 3)
+    {
+        unsigned int triangleLowest = std::min({ indices[i], indices[i + 1], indices[i + 2] });
+        unsigned int triangleHighest = std::max({ indices[i], indices[i + 1], indices[i + 2] });
+        if (triangleHighest - triangleLowest > 0xFFFF) chunked = false;
+
+        if (i == start)
+        {
+            lowest = triangleLowest;
+            highest = triangleHighest;
+        }
+        else if (std::max(highest, triangleHighest) - std::min(lowest, triangleLowest) > 0xFFFF)
+        {
+            chunks.push_back({ start, i - start, (int) lowest });
+            start = i;
+            lowest = triangleLowest;
+            highest = triangleHighest;
+        }
+        else
+        {
+            lowest = std::min(lowest, triangleLowest);
+            highest = std::max(highest, triangleHighest);
+        }
+    }
+    if (start < indexCount) chunks.push_back({ start, indexCount - start, (int) lowest });
+
+    // Each chunk is another draw call; only worth it while chunks stay large (i.e. the mesh has locality)
+    const unsigned int minimumChunkSize = 16384;
+    if (chunked && chunks.size() * minimumChunkSize <= indexCount)
+    {
+        m_Chunks = std::move(chunks);
+        return;
+    }
+
+    m_IndexType = GL_UNSIGNED_INT;
+    m_IndexSize = 4;
+}
+
+bool Mesh::packIndex(unsigned int position, unsigned int index, unsigned char* destination) const
+{
+    // Chunks are sorted by first index; find the one containing this position
+    auto chunk = std::upper_bound(m_Chunks.begin(), m_Chunks.end(), position,
+                                  [](unsigned int value, const IndexChunk& c) { return value < c.firstIndex; }) - 1;
+
+    unsigned int relative = index - (unsigned int) chunk->baseVertex;
+    if (index < (unsigned int) chunk->baseVertex || (m_IndexSize < 4 && relative >= 1u << (8 * m_IndexSize))) return false;
+
+    if (m_IndexSize == 1) *destination = (unsigned char) relative;
+    else if (m_IndexSize == 2)
+    {
+        auto value = (unsigned short) relative;
+        std::memcpy(destination, &value, sizeof(value));
+    }
+    else std::memcpy(destination, &relative, sizeof(relative));
+    return true;
+}
+
+void Mesh::draw(unsigned int instanceCount)
+{
+    // The IBO is part of the VAO, so one (usually elided) bind is all a draw needs
+    GLStateCache::bindVertexArray(m_VAO);
 
-    glBindVertexArray(0);
+    for (const IndexChunk& chunk : m_Chunks)
+    {
+        auto offset = (const void*) ((size_t) m_IndexSize * chunk.firstIndex);
+        if (instanceCount == 0 && chunk.baseVertex == 0)
+            glDrawElements(GL_TRIANGLES, (GLsizei) chunk.indexCount, m_IndexType, offset);
+        else if (instanceCount == 0)
+            glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei) chunk.indexCount, m_IndexType, offset, chunk.baseVertex);
+        else
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei) chunk.indexCount, m_IndexType, offset,
+                                              (GLsizei) instanceCount, chunk.baseVertex);
+        RenderStats::countDraw();
+    }
 }
 
 void Mesh::render()
 {
-    glBindVertexArray(m_VAO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBO);
-    glDrawElements(GL_TRIANGLES, m_IndexCount, GL_UNSIGNED_INT, nullptr);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    TRACE_SCOPE("Mesh::render");
+
+    flushUpdates();
+    draw(0);
+}
+
+void Mesh::updateVertices(unsigned int offset, std::span<const float> vertices)
+{
+    updateVertexData(sizeof(float) * offset, vertices.data(), vertices.size_bytes());
+}
+
+void Mesh::updateVertexData(size_t byteOffset, const void* data, size_t size)
+{
+    if (byteOffset + size > m_VertexBytes)
+    {
+        std::cout << "Vertex update [" << byteOffset << ", " << byteOffset + size << ") is outside the mesh ("
+                  << m_VertexBytes << " bytes)\n";
+        return;
+    }
+
+    m_VertexUpdates.add(byteOffset, data, size);
+}
+
+void Mesh::updateIndices(unsigned int offset, std::span<const unsigned int> indices)
+{
+    if (offset + indices.size() > m_IndexCount)
+    {
+        std::cout << "Index update [" << offset << ", " << offset + indices.size() << ") is outside the mesh ("
+                  << m_IndexCount << " indices)\n";
+        return;
+    }
+
+    // Indices are stored narrowed and relative to their chunk, so convert them the same way
+    std::vector<unsigned char> packed((size_t) m_IndexSize * indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        if (!packIndex(offset + (unsigned int) i, indices[i], packed.data() + (size_t) m_IndexSize * i))
+        {
+            std::cout << "Index " << indices[i] << " at " << offset + i << " doesn't fit the mesh's "
+                      << 8 * m_IndexSize << "-bit index range\n";
+            return;
+        }
+    }
+
+    m_IndexUpdates.add((size_t) m_IndexSize * offset, packed.data(), packed.size());
+}
+
+void Mesh::flushUpdates()
+{
+    if (m_VertexUpdates.empty() && m_IndexUpdates.empty()) return;
+    TRACE_SCOPE("Mesh::flushUpdates");
+
+    m_VertexUpdates.upload(m_VBO);
+    m_IndexUpdates.upload(m_IBO);
+}
+
+void Mesh::PendingUpdates::add(size_t offset, const void* data, size_t size)
+{
+    if (size == 0) return;
+
+    m_Writes.push_back({ offset, size, m_Staging.size() });
+    m_Staging.insert(m_Staging.end(), (const unsigned char*) data, (const unsigned char*) data + size);
+}
+
+void Mesh::PendingUpdates::upload(unsigned int buffer)
+{
+    if (m_Writes.empty()) return;
+
+    // Upload through the copy target so neither the bound VAO nor GL_ARRAY_BUFFER changes
+    GLStateCache::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+
+    // Visit writes by destination, keeping submission order among equal offsets
+    std::vector<size_t> order(m_Writes.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return m_Writes[a].offset < m_Writes[b].offset; });
+
+    size_t runBegin = 0;
+    while (runBegin < order.size())
+    {
+        // Extend the run while the next write overlaps or touches it
+        size_t start = m_Writes[order[runBegin]].offset;
+        size_t end = start + m_Writes[order[runBegin]].size;
+        size_t runEnd = runBegin + 1;
+        while (runEnd < order.size() && m_Writes[order[runEnd]].offset <= end)
+        {
+            end = std::max(end, m_Writes[order[runEnd]].offset + m_Writes[order[runEnd]].size);
+            runEnd++;
+        }
+
+        if (runEnd - runBegin == 1)
+        {
+            const Write& write = m_Writes[order[runBegin]];
+            glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr) write.offset, (GLsizeiptr) write.size, m_Staging.data() + write.source);
+        }
+        else
+        {
+            // Replay the run's writes in submission order so later ones overwrite earlier ones
+            std::sort(order.begin() + (long) runBegin, order.begin() + (long) runEnd);
+
+            m_Merged.resize(end - start);
+            for (size_t i = runBegin; i < runEnd; i++)
+            {
+                const Write& write = m_Writes[order[i]];
+                std::memcpy(m_Merged.data() + (write.offset - start), m_Staging.data() + write.source, write.size);
+            }
+            glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr) start, (GLsizeiptr) (end - start), m_Merged.data());
+        }
+
+        RenderStats::countUpload(end - start);
+        runBegin = runEnd;
+    }
+
+    clear();
+}
+
+void Mesh::PendingUpdates::clear()
+{
+    // Keep the capacity; meshes that are edited once tend to be edited every frame
+    m_Writes.clear();
+    m_Staging.clear();
+}
+
+void Mesh::setInstances(const glm::mat4* transforms, unsigned int count)
+{
+    if (m_InstanceVBO == 0)
+    {
+        glGenBuffers(1, &m_InstanceVBO);
+
+        // A mat4 attribute takes four consecutive locations, one vec4 column each
+        GLStateCache::bindVertexArray(m_VAO);
+        GLStateCache::bindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            glVertexAttribPointer(1 + column, 4, GL_FLOAT, false, sizeof(glm::mat4), (void*) (sizeof(glm::vec4) * column));
+            glEnableVertexAttribArray(1 + column);
+
+            // Advance once per instance instead of once per vertex
+            glVertexAttribDivisor(1 + column, 1);
+        }
+    }
+    else
+    {
+        GLStateCache::bindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+    }
+
+    // Grow the buffer when needed, otherwise orphan it so the driver doesn't wait on draws still using it
+    if (count > m_InstanceCapacity) m_InstanceCapacity = count;
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * m_InstanceCapacity, nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::mat4) * count, transforms);
+    RenderStats::countUpload(sizeof(glm::mat4) * count);
+}
+
+void Mesh::renderInstanced(unsigned int count)
+{
+    flushUpdates();
+    if (count != 0) draw(count);
 }
 
 void Mesh::clear()
 {
+    if (m_InstanceVBO != 0)
+    {
+        GLStateCache::forgetBuffer(m_InstanceVBO);
+        glDeleteBuffers(1, &m_InstanceVBO);
+        m_InstanceVBO = 0;
+    }
+
     if (m_IBO != 0)
     {
+        GLStateCache::forgetBuffer(m_IBO);
         glDeleteBuffers(1, &m_IBO);
         m_IBO = 0;
     }
 
     if (m_VBO != 0)
     {
+        GLStateCache::forgetBuffer(m_VBO);
         glDeleteBuffers(1, &m_VBO);
         m_VBO = 0;
     }
 
     if (m_VAO != 0)
     {
+        GLStateCache::forgetVertexArray(m_VAO);
         glDeleteVertexArrays(1, &m_VAO);
         m_VAO = 0;
     }
 
+    m_VertexUpdates.clear();
+    m_IndexUpdates.clear();
+    m_VertexBytes = 0;
+    m_VertexStride = 0;
     m_IndexCount = 0;
+    m_Chunks.clear();
+    m_InstanceCapacity = 0;
 }
\ No newline at end of file
@@ -4,17 +4,95 @@
 
 #pragma once
 #include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+#include "vertexlayout.h"
 
 class Mesh
 {
 private:
-    unsigned int m_VAO, m_VBO, m_IBO;
-    size_t m_IndexCount;
+    // Partial writes to one buffer, staged until the next flush
+    class PendingUpdates
+    {
+    private:
+        struct Write
+        {
+            size_t offset, size;    // Destination range in the buffer, in bytes
+            size_t source;          // Start of the data in m_Staging
+        };
+
+        std::vector<Write> m_Writes;
+        std::vector<unsigned char> m_Staging, m_Merged;
+    public:
+        void add(size_t offset, const void* data, size_t size);
+
+        // Coalesces overlapping and touching writes (later writes win) and uploads each run once
+        void upload(unsigned int buffer);
+        void clear();
+        bool empty() const { return m_Writes.empty(); }
+    };
+
+    // A run of indices small enough to address relative to its own base vertex
+    struct IndexChunk
+    {
+        unsigned int firstIndex, indexCount;
+        int baseVertex;
+    };
+
+    unsigned int m_VAO, m_VBO, m_IBO, m_InstanceVBO;
+    size_t m_VertexBytes, m_IndexCount, m_InstanceCapacity;
+    unsigned int m_VertexStride;
+    PendingUpdates m_VertexUpdates, m_IndexUpdates;
+
+    // Narrowest index type that fits; meshes past 65536 vertices are split into chunks when that
+    // keeps 16-bit indices without too many extra draws
+    GLenum m_IndexType;
+    unsigned int m_IndexSize;
+    std::vector<IndexChunk> m_Chunks;
+
+    static bool s_ByteIndices;
+private:
+    void upload(const void* vertices, unsigned int vertexCount, const void* indices, unsigned int indexCount,
+                const VertexLayout& layout);
+    void chooseIndexFormat(const unsigned int* indices, unsigned int indexCount);
+    bool packIndex(unsigned int position, unsigned int index, unsigned char* destination) const;
+    void draw(unsigned int instanceCount);
 public:
     Mesh();
     ~Mesh();
 
+    // Positions only: vertexCount is the number of floats (three per vertex)
     void create(float* vertices, unsigned int* indices, unsigned int vertexCount, unsigned int indexCount);
+
+    // Interleaved vertices in the given layout: vertexCount is the number of vertices, each layout.getStride() bytes
+    void create(const void* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount,
+                const VertexLayout& layout);
+
+    // Indices already in a GL index type (GL_UNSIGNED_BYTE/SHORT/INT) are uploaded as they are, e.g. straight
+    // out of a mapped file; 8-bit ones are widened to 16 bits unless setByteIndicesEnabled(true)
+    void create(const void* vertices, unsigned int vertexCount, const void* indices, GLenum indexType,
+                unsigned int indexCount, const VertexLayout& layout);
     void render();
+
+    // Overwrite part of the vertex (in floats) or index data in place; the writes are merged and
+    // uploaded by flushUpdates(), which render() calls, so the cost follows the size of the change
+    void updateVertices(unsigned int offset, std::span<const float> vertices);
+    void updateVertexData(size_t byteOffset, const void* data, size_t size);
+    void updateIndices(unsigned int offset, std::span<const unsigned int> indices);
+    void flushUpdates();
+
+    constexpr unsigned int getVAO() const { return m_VAO; }
+    constexpr unsigned int getVertexStride() const { return m_VertexStride; }
+    constexpr GLenum getIndexType() const { return m_IndexType; }
+    size_t getChunkCount() const { return m_Chunks.size(); }
+
+    // 8-bit indices are off by default: many desktop GPUs lack them and the driver converts on every draw
+    static void setByteIndicesEnabled(bool enabled) { s_ByteIndices = enabled; }
+
+    // Per-instance model matrices, read by Shaders/instanced.vertex at locations 1-4
+    void setInstances(const glm::mat4* transforms, unsigned int count);
+    void renderInstanced(unsigned int count);
     void clear();
 };
\ No newline at end of file
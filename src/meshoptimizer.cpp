@@ -0,0 +1,321 @@
+//
+// Index and vertex reordering for faster rendering
+//
+
+#include "meshoptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace
+{
+    // FIFO post-transform cache simulated with timestamps: a vertex is cached while fewer than
+    // cacheSize misses have happened since it was last loaded
+    class CacheSimulator
+    {
+    private:
+        std::vector<unsigned int> m_LoadTime;
+        unsigned int m_Time, m_CacheSize;
+    public:
+        CacheSimulator(size_t vertexCount, unsigned int cacheSize)
+            : m_LoadTime(vertexCount, 0), m_Time(cacheSize + 1), m_CacheSize(cacheSize)
+        {}
+
+        bool isCached(unsigned int vertex) const { return m_Time - m_LoadTime[vertex] <= m_CacheSize; }
+
+        // Returns whether the vertex had to be transformed
+        bool access(unsigned int vertex)
+        {
+            if (isCached(vertex)) return false;
+            m_LoadTime[vertex] = m_Time++;
+            return true;
+        }
+
+        unsigned int accessTriangle(const unsigned int* triangle)
+        {
+            return access(triangle[0]) + access(triangle[1]) + access(triangle[2]);
+        }
+
+        unsigned int getTime() const { return m_Time; }
+        unsigned int getLoadTime(unsigned int vertex) const { return m_LoadTime[vertex]; }
+        void flush() { m_Time += m_CacheSize + 1; }
+    };
+
+    struct Position
+    {
+        float x, y, z;
+    };
+
+    Position readPosition(const void* vertices, size_t vertexStride, size_t positionOffset, unsigned int vertex)
+    {
+        Position position;
+        std::memcpy(&position, (const unsigned char*) vertices + vertexStride * vertex + positionOffset, sizeof(position));
+        return position;
+    }
+}
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount,
+                                                   unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    if (indexCount < 3) return stats;
+
+    CacheSimulator cache(vertexCount, cacheSize);
+    std::vector<bool> used(vertexCount, false);
+    size_t misses = 0, unique = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        misses += cache.access(indices[i]);
+        if (!used[indices[i]])
+        {
+            used[indices[i]] = true;
+            unique++;
+        }
+    }
+
+    stats.acmr = (float) misses / (float) (indexCount / 3);
+    stats.atvr = (float) misses / (float) unique;
+    return stats;
+}
+
+std::vector<size_t> MeshOptimizer::optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount,
+                                                       unsigned int cacheSize)
+{
+    std::vector<size_t> clusterStarts;
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return clusterStarts;
+
+    // Triangles around each vertex, as one flat array with per-vertex offsets
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++) liveTriangles[indices[i]]++;
+
+    std::vector<size_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++)
+        adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + liveTriangles[vertex];
+
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t triangle = 0; triangle < triangleCount; triangle++)
+        for (int corner = 0; corner < 3; corner++)
+            adjacency[fill[indices[triangle * 3 + corner]]++] = (unsigned int) triangle;
+
+    CacheSimulator cache(vertexCount, cacheSize);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnd, candidates, output;
+    output.reserve(triangleCount * 3);
+
+    size_t cursor = 0;
+    long fan = indices[0];
+    while (fan >= 0)
+    {
+        // A fan vertex that isn't cached any more means the following triangles start cold
+        if (!cache.isCached((unsigned int) fan)) clusterStarts.push_back(output.size() / 3);
+
+        // Emit every remaining triangle around the fan vertex
+        candidates.clear();
+        for (size_t a = adjacencyOffsets[fan]; a < adjacencyOffsets[fan + 1]; a++)
+        {
+            unsigned int triangle = adjacency[a];
+            if (emitted[triangle]) continue;
+            emitted[triangle] = true;
+
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int vertex = indices[triangle * 3 + corner];
+                output.push_back(vertex);
+                deadEnd.push_back(vertex);
+                candidates.push_back(vertex);
+                liveTriangles[vertex]--;
+                cache.access(vertex);
+            }
+        }
+
+        // Next fan: the candidate that will still be cached after its remaining triangles are
+        // emitted, preferring the one that entered the cache earliest
+        fan = -1;
+        long bestPriority = -1;
+        for (unsigned int vertex : candidates)
+        {
+            if (liveTriangles[vertex] == 0) continue;
+
+            long age = (long) (cache.getTime() - cache.getLoadTime(vertex));
+            long priority = age + 2 * (long) liveTriangles[vertex] <= (long) cacheSize ? age : 0;
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                fan = vertex;
+            }
+        }
+
+        if (fan >= 0) continue;
+
+        // Dead end: back up through recently used vertices, then fall back to input order
+        while (!deadEnd.empty() && fan < 0)
+        {
+            unsigned int vertex = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveTriangles[vertex] > 0) fan = vertex;
+        }
+
+        while (fan < 0 && cursor < triangleCount * 3)
+        {
+            unsigned int vertex = indices[cursor++];
+            if (liveTriangles[vertex] > 0) fan = vertex;
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+    return clusterStarts;
+}
+
+void MeshOptimizer::optimizeOverdraw(unsigned int* indices, size_t indexCount, const void* vertices, size_t vertexStride,
+                                     size_t positionOffset, const std::vector<size_t>& clusterStarts,
+                                     unsigned int cacheSize, float threshold)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return;
+
+    size_t vertexCount = 0;
+    for (size_t i = 0; i < triangleCount * 3; i++) vertexCount = std::max(vertexCount, (size_t) indices[i] + 1);
+
+    std::vector<size_t> hardStarts = clusterStarts;
+    if (hardStarts.empty() || hardStarts.front() != 0) hardStarts.insert(hardStarts.begin(), 0);
+    hardStarts.push_back(triangleCount);
+
+    // Split hard clusters further wherever the part so far already has an ACMR within threshold
+    // of the whole cluster, i.e. where restarting with a cold cache costs little
+    CacheSimulator cache(vertexCount, cacheSize);
+    std::vector<size_t> starts;
+    for (size_t cluster = 0; cluster + 1 < hardStarts.size(); cluster++)
+    {
+        size_t begin = hardStarts[cluster], end = hardStarts[cluster + 1];
+        if (begin >= end) continue;
+
+        cache.flush();
+        size_t clusterMisses = 0;
+        for (size_t triangle = begin; triangle < end; triangle++) clusterMisses += cache.accessTriangle(indices + triangle * 3);
+        float clusterThreshold = threshold * (float) clusterMisses / (float) (end - begin);
+
+        cache.flush();
+        size_t runMisses = 0, runStart = begin;
+        starts.push_back(begin);
+        for (size_t triangle = begin; triangle < end; triangle++)
+        {
+            runMisses += cache.accessTriangle(indices + triangle * 3);
+            if (triangle + 1 < end && (float) runMisses <= clusterThreshold * (float) (triangle + 1 - runStart))
+            {
+                starts.push_back(triangle + 1);
+                runStart = triangle + 1;
+                runMisses = 0;
+                cache.flush();
+            }
+        }
+    }
+    starts.push_back(triangleCount);
+
+    // Area-weighted centroid and normal of every cluster, and the mesh centroid
+    size_t clusterCount = starts.size() - 1;
+    std::vector<Position> centroids(clusterCount), normals(clusterCount);
+    std::vector<float> areas(clusterCount, 0.0f);
+    Position meshCentroid { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+
+    for (size_t cluster = 0; cluster < clusterCount; cluster++)
+    {
+        Position centroid { 0.0f, 0.0f, 0.0f }, normal { 0.0f, 0.0f, 0.0f };
+        float area = 0.0f;
+        for (size_t triangle = starts[cluster]; triangle < starts[cluster + 1]; triangle++)
+        {
+            Position a = readPosition(vertices, vertexStride, positionOffset, indices[triangle * 3]);
+            Position b = readPosition(vertices, vertexStride, positionOffset, indices[triangle * 3 + 1]);
+            Position c = readPosition(vertices, vertexStride, positionOffset, indices[triangle * 3 + 2]);
+
+            float ex = b.x - a.x, ey = b.y - a.y, ez = b.z - a.z;
+            float fx = c.x - a.x, fy = c.y - a.y, fz = c.z - a.z;
+            float nx = ey * fz - ez * fy, ny = ez * fx - ex * fz, nz = ex * fy - ey * fx;
+            float triangleArea = std::sqrt(nx * nx + ny * ny + nz * nz);
+
+            centroid.x += (a.x + b.x + c.x) * triangleArea;
+            centroid.y += (a.y + b.y + c.y) * triangleArea;
+            centroid.z += (a.z + b.z + c.z) * triangleArea;
+            normal.x += nx;
+            normal.y += ny;
+            normal.z += nz;
+            area += triangleArea;
+        }
+
+        meshCentroid.x += centroid.x;
+        meshCentroid.y += centroid.y;
+        meshCentroid.z += centroid.z;
+        meshArea += area;
+
+        float scale = area > 0.0f ? 1.0f / (3.0f * area) : 0.0f;
+        centroids[cluster] = { centroid.x * scale, centroid.y * scale, centroid.z * scale };
+        normals[cluster] = normal;
+        areas[cluster] = area;
+    }
+
+    float meshScale = meshArea > 0.0f ? 1.0f / (3.0f * meshArea) : 0.0f;
+    meshCentroid = { meshCentroid.x * meshScale, meshCentroid.y * meshScale, meshCentroid.z * meshScale };
+
+    // Clusters far out along their own normal tend to occlude the rest of the mesh, so draw them first
+    std::vector<float> occlusion(clusterCount);
+    for (size_t cluster = 0; cluster < clusterCount; cluster++)
+    {
+        const Position& normal = normals[cluster];
+        float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        if (length == 0.0f) continue;
+
+        occlusion[cluster] = ((centroids[cluster].x - meshCentroid.x) * normal.x + (centroids[cluster].y - meshCentroid.y) * normal.y +
+                              (centroids[cluster].z - meshCentroid.z) * normal.z) / length;
+    }
+
+    std::vector<size_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return occlusion[a] > occlusion[b]; });
+
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+    for (size_t cluster : order)
+        output.insert(output.end(), indices + starts[cluster] * 3, indices + starts[cluster + 1] * 3);
+    std::copy(output.begin(), output.end(), indices);
+}
+
+size_t MeshOptimizer::optimizeVertexFetch(void* vertices, size_t vertexStride, unsigned int* indices, size_t indexCount,
+                                          size_t vertexCount)
+{
+    // Number vertices in the order the index buffer first touches them
+    std::vector<unsigned int> remap(vertexCount, ~0u);
+    unsigned int next = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        unsigned int& target = remap[indices[i]];
+        if (target == ~0u) target = next++;
+        indices[i] = target;
+    }
+
+    std::vector<unsigned char> reordered((size_t) next * vertexStride);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++)
+    {
+        if (remap[vertex] == ~0u) continue;
+        std::memcpy(reordered.data() + vertexStride * remap[vertex], (const unsigned char*) vertices + vertexStride * vertex, vertexStride);
+    }
+
+    std::memcpy(vertices, reordered.data(), reordered.size());
+    return next;
+}
+
+size_t MeshOptimizer::optimize(void* vertices, size_t vertexStride, size_t positionOffset, unsigned int* indices,
+                               size_t indexCount, size_t vertexCount, VertexCacheStats* before, VertexCacheStats* after)
+{
+    if (before != nullptr) *before = analyzeVertexCache(indices, indexCount, vertexCount);
+
+    std::vector<size_t> clusterStarts = optimizeVertexCache(indices, indexCount, vertexCount);
+    optimizeOverdraw(indices, indexCount, vertices, vertexStride, positionOffset, clusterStarts);
+    vertexCount = optimizeVertexFetch(vertices, vertexStride, indices, indexCount, vertexCount);
+
+    if (after != nullptr) *after = analyzeVertexCache(indices, indexCount, vertexCount);
+    return vertexCount;
+}
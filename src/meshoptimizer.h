@@ -0,0 +1,55 @@
+//
+// Index and vertex reordering for faster rendering
+//
+
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// How well an index buffer uses a FIFO post-transform cache
+struct VertexCacheStats
+{
+    float acmr = 0.0f;      // Average cache miss ratio: vertex shader runs per triangle (0.5 is ideal, 3 is worst)
+    float atvr = 0.0f;      // Average transform to vertex ratio: shader runs per unique vertex (1 is ideal)
+};
+
+/* Reorders triangle lists before upload so the GPU shades fewer vertices, overdraws less and
+ * fetches vertices sequentially:
+ *
+ *   1. optimizeVertexCache: Tipsify (Sander, Nehab and Barczak 2007) orders triangles so their
+ *      vertices are still in the post-transform cache when reused.
+ *   2. optimizeOverdraw: splits that order into clusters where the cache was flushed anyway (or
+ *      where splitting costs little) and sorts them so outward-facing, likely occluding clusters
+ *      draw first.
+ *   3. optimizeVertexFetch: renumbers vertices in first-use order and drops unused ones.
+ *
+ * optimize() runs all three; positions must be three floats inside each vertex.
+ */
+class MeshOptimizer
+{
+public:
+    MeshOptimizer() = delete;
+
+    static constexpr unsigned int defaultCacheSize = 16;
+
+    static VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount,
+                                               unsigned int cacheSize = defaultCacheSize);
+
+    // Returns the first triangle of each run that starts from a cold cache, for optimizeOverdraw()
+    static std::vector<size_t> optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount,
+                                                   unsigned int cacheSize = defaultCacheSize);
+
+    // threshold is how much ACMR a cluster split may cost (1.05 = 5% worse)
+    static void optimizeOverdraw(unsigned int* indices, size_t indexCount, const void* vertices, size_t vertexStride,
+                                 size_t positionOffset, const std::vector<size_t>& clusterStarts,
+                                 unsigned int cacheSize = defaultCacheSize, float threshold = 1.05f);
+
+    // Reorders vertices in place and rewrites the indices; returns the new vertex count
+    static size_t optimizeVertexFetch(void* vertices, size_t vertexStride, unsigned int* indices, size_t indexCount,
+                                      size_t vertexCount);
+
+    // Runs every pass; before/after (if given) receive the cache statistics on either side
+    static size_t optimize(void* vertices, size_t vertexStride, size_t positionOffset, unsigned int* indices,
+                           size_t indexCount, size_t vertexCount, VertexCacheStats* before = nullptr,
+                           VertexCacheStats* after = nullptr);
+};
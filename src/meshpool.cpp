@@ -0,0 +1,150 @@
+//
+// Shared vertex/index storage for static meshes
+//
+
+#include "meshpool.h"
+#include "statecache.h"
+#include "renderstats.h"
+
+#include <iostream>
+
+MeshPool::MeshPool() : m_VAO(0), m_VBO(0), m_IBO(0), m_IndirectBuffer(0),
+                       m_VertexCapacity(0), m_IndexCapacity(0), m_VertexCount(0), m_IndexCount(0),
+                       m_UseIndirect(false), m_CommandsDirty(false)
+{}
+
+MeshPool::~MeshPool()
+{
+    clear();
+}
+
+void MeshPool::create(unsigned int vertexCapacity, unsigned int indexCapacity)
+{
+    m_VertexCapacity = vertexCapacity;
+    m_IndexCapacity = indexCapacity;
+    m_UseIndirect = GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+
+    glGenVertexArrays(1, &m_VAO);
+    GLStateCache::bindVertexArray(m_VAO);
+
+    // Allocate both buffers up front; meshes are copied in with glBufferSubData as they are added
+    glGenBuffers(1, &m_IBO);
+    GLStateCache::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indexCapacity, nullptr, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &m_VBO);
+    GLStateCache::bindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertexCapacity, nullptr, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, false, 0, nullptr);
+    glEnableVertexAttribArray(0);
+
+    if (m_UseIndirect) glGenBuffers(1, &m_IndirectBuffer);
+}
+
+int MeshPool::add(const float* vertices, const unsigned int* indices, unsigned int vertexCount, unsigned int indexCount)
+{
+    if (m_VertexCount + vertexCount > m_VertexCapacity || m_IndexCount + indexCount > m_IndexCapacity)
+    {
+        std::cout << "Mesh pool is full (" << m_VertexCount << '/' << m_VertexCapacity << " floats, "
+                  << m_IndexCount << '/' << m_IndexCapacity << " indices)\n";
+        return -1;
+    }
+
+    // Indices stay relative to the mesh; the base vertex offsets them into the shared buffer
+    GLStateCache::bindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * m_VertexCount, sizeof(float) * vertexCount, vertices);
+
+    // Upload indices through the copy target so whichever VAO is bound keeps its element buffer
+    GLStateCache::bindBuffer(GL_COPY_WRITE_BUFFER, m_IBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(unsigned int) * m_IndexCount, sizeof(unsigned int) * indexCount, indices);
+    RenderStats::countUpload(sizeof(float) * vertexCount + sizeof(unsigned int) * indexCount);
+
+    DrawCommand command {};
+    command.count = indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = m_IndexCount;
+    command.baseVertex = (int) (m_VertexCount / 3);
+    command.baseInstance = (unsigned int) m_Commands.size();
+    m_Commands.push_back(command);
+
+    m_Counts.push_back((GLsizei) indexCount);
+    m_Offsets.push_back((const void*) (sizeof(unsigned int) * m_IndexCount));
+    m_BaseVertices.push_back(command.baseVertex);
+
+    m_VertexCount += vertexCount;
+    m_IndexCount += indexCount;
+    m_CommandsDirty = true;
+
+    return (int) m_Commands.size() - 1;
+}
+
+void MeshPool::render()
+{
+    if (m_Commands.empty()) return;
+
+    GLStateCache::bindVertexArray(m_VAO);
+
+    if (m_UseIndirect)
+    {
+        GLStateCache::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+
+        // Commands only change when meshes are added, so they are uploaded lazily
+        if (m_CommandsDirty)
+        {
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawCommand) * m_Commands.size(), m_Commands.data(), GL_STATIC_DRAW);
+            RenderStats::countUpload(sizeof(DrawCommand) * m_Commands.size());
+            m_CommandsDirty = false;
+        }
+
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei) m_Commands.size(), 0);
+    }
+    else
+    {
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_Counts.data(), GL_UNSIGNED_INT, m_Offsets.data(),
+                                      (GLsizei) m_Commands.size(), m_BaseVertices.data());
+    }
+
+    // One multi-draw regardless of how many meshes it covers
+    RenderStats::countDraw();
+}
+
+void MeshPool::clear()
+{
+    if (m_IndirectBuffer != 0)
+    {
+        GLStateCache::forgetBuffer(m_IndirectBuffer);
+        glDeleteBuffers(1, &m_IndirectBuffer);
+        m_IndirectBuffer = 0;
+    }
+
+    if (m_IBO != 0)
+    {
+        GLStateCache::forgetBuffer(m_IBO);
+        glDeleteBuffers(1, &m_IBO);
+        m_IBO = 0;
+    }
+
+    if (m_VBO != 0)
+    {
+        GLStateCache::forgetBuffer(m_VBO);
+        glDeleteBuffers(1, &m_VBO);
+        m_VBO = 0;
+    }
+
+    if (m_VAO != 0)
+    {
+        GLStateCache::forgetVertexArray(m_VAO);
+        glDeleteVertexArrays(1, &m_VAO);
+        m_VAO = 0;
+    }
+
+    m_Commands.clear();
+    m_Counts.clear();
+    m_Offsets.clear();
+    m_BaseVertices.clear();
+
+    m_VertexCapacity = m_IndexCapacity = 0;
+    m_VertexCount = m_IndexCount = 0;
+    m_CommandsDirty = false;
+}
@@ -0,0 +1,52 @@
+//
+// Shared vertex/index storage for static meshes
+//
+
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+
+/* Suballocates many static meshes from one vertex buffer and one index buffer behind a single
+ * VAO, so the whole pool renders with one draw call instead of one bind + draw per mesh.
+ * Uses glMultiDrawElementsIndirect on GL 4.3+ and glMultiDrawElementsBaseVertex on GL 3.3.
+ * Vertices use the same layout as Mesh: tightly packed vec3 positions at location 0.
+ */
+class MeshPool
+{
+public:
+    MeshPool();
+    ~MeshPool();
+private:
+    // Matches the DrawElementsIndirectCommand layout read by the GPU
+    struct DrawCommand
+    {
+        unsigned int count;
+        unsigned int instanceCount;
+        unsigned int firstIndex;
+        int baseVertex;
+        unsigned int baseInstance;
+    };
+
+    unsigned int m_VAO, m_VBO, m_IBO, m_IndirectBuffer;
+    unsigned int m_VertexCapacity, m_IndexCapacity;
+    unsigned int m_VertexCount, m_IndexCount;
+    bool m_UseIndirect, m_CommandsDirty;
+
+    std::vector<DrawCommand> m_Commands;
+
+    // Fallback arguments for glMultiDrawElementsBaseVertex
+    std::vector<GLsizei> m_Counts;
+    std::vector<const void*> m_Offsets;
+    std::vector<GLint> m_BaseVertices;
+public:
+    // Capacities are in floats and indices, like the counts passed to Mesh::create()
+    void create(unsigned int vertexCapacity, unsigned int indexCapacity);
+
+    // Returns the mesh's index in the pool, or -1 if the pool is full
+    int add(const float* vertices, const unsigned int* indices, unsigned int vertexCount, unsigned int indexCount);
+    void render();
+    void clear();
+
+    size_t getMeshCount() const { return m_Commands.size(); }
+    constexpr bool usesIndirect() const { return m_UseIndirect; }
+};
@@ -0,0 +1,827 @@
+//
+// OBJ and PLY model loading
+//
+
+#include "modelloader.h"
+#include "mappedfile.h"
+#include "meshoptimizer.h"
+#include "trace.h"
+#include "vertexwelder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace
+{
+    constexpr uint32_t noIndex = UINT32_MAX;
+
+    // Runs function(part) for every part in [0, parts), the first one on the calling thread
+    template<typename Function>
+    void runParallel(size_t parts, const Function& function)
+    {
+        std::vector<std::thread> workers;
+        for (size_t part = 1; part < parts; part++) workers.emplace_back([&function, part] { function(part); });
+        if (parts > 0) function(0);
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    size_t partCount(unsigned int threads, size_t items, size_t minimumPerPart)
+    {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        size_t parts = std::min<size_t>(std::max(1u, threads), items / minimumPerPart);
+        return std::max<size_t>(parts, 1);
+    }
+
+    // Items [first, last) of part out of parts
+    std::pair<size_t, size_t> partRange(size_t items, size_t parts, size_t part)
+    {
+        return {items * part / parts, items * (part + 1) / parts};
+    }
+
+    VertexLayout modelLayout(bool normals, bool texCoords)
+    {
+        VertexLayout layout;
+        layout.add(PositionAttribute, 3);
+        if (normals) layout.add(NormalAttribute, 3);
+        if (texCoords) layout.add(TexCoordAttribute, 2);
+        return layout;
+    }
+
+    // --- OBJ ---
+
+    enum class ObjLine { Position, Normal, TexCoord, Face, Other };
+
+    struct ObjCounts
+    {
+        size_t positions = 0, normals = 0, texCoords = 0;
+    };
+
+    struct ObjChunk
+    {
+        const char* begin;
+        const char* end;
+        ObjCounts counts, base;         // Elements in this chunk, and in all chunks before it
+        std::vector<uint32_t> corners;  // Position, UV and normal index of each triangle corner (noIndex = none)
+    };
+
+    // '\r' counts as a blank so CRLF files parse like LF ones
+    bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    const char* skipBlanks(const char* p, const char* end)
+    {
+        while (p < end && isBlank(*p)) p++;
+        return p;
+    }
+
+    const char* findLineEnd(const char* p, const char* end)
+    {
+        auto newline = (const char*) std::memchr(p, '\n', end - p);
+        return newline != nullptr ? newline : end;
+    }
+
+    // Identifies the line at p (up to end) and moves p past its keyword
+    ObjLine classifyLine(const char*& p, const char* end)
+    {
+        p = skipBlanks(p, end);
+        if (end - p < 2) return ObjLine::Other;
+
+        if (p[0] == 'f' && isBlank(p[1]))
+        {
+            p += 2;
+            return ObjLine::Face;
+        }
+        if (p[0] != 'v') return ObjLine::Other;
+
+        if (isBlank(p[1]))
+        {
+            p += 2;
+            return ObjLine::Position;
+        }
+        if (end - p >= 3 && isBlank(p[2]) && (p[1] == 'n' || p[1] == 't'))
+        {
+            ObjLine line = p[1] == 'n' ? ObjLine::Normal : ObjLine::TexCoord;
+            p += 3;
+            return line;
+        }
+        return ObjLine::Other;
+    }
+
+    // Parses up to count floats; returns how many were read
+    int parseFloats(const char* p, const char* end, float* values, int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            p = skipBlanks(p, end);
+            auto result = std::from_chars(p, end, values[i]);
+            if (result.ec != std::errc()) return i;
+            p = result.ptr;
+        }
+        return count;
+    }
+
+    // OBJ indices are 1-based, or negative to count back from the latest element seen so far
+    bool parseIndex(const char*& p, const char* end, size_t seen, uint32_t& index)
+    {
+        long long value;
+        auto result = std::from_chars(p, end, value);
+        if (result.ec != std::errc() || value == 0) return false;
+        p = result.ptr;
+
+        long long resolved = value > 0 ? value - 1 : (long long) seen + value;
+        if (resolved < 0 || resolved >= noIndex) return false;
+        index = (uint32_t) resolved;
+        return true;
+    }
+
+    // v, v/vt, v//vn or v/vt/vn corners; polygons are split into a triangle fan
+    bool parseFace(const char* p, const char* end, const ObjCounts& seen, std::vector<uint32_t>& corners)
+    {
+        uint32_t first[3], previous[3];
+        int cornerCount = 0;
+        for (p = skipBlanks(p, end); p < end; p = skipBlanks(p, end))
+        {
+            uint32_t corner[3] = {noIndex, noIndex, noIndex};
+            if (!parseIndex(p, end, seen.positions, corner[0])) return false;
+            if (p < end && *p == '/')
+            {
+                p++;
+                if (p < end && *p != '/' && !parseIndex(p, end, seen.texCoords, corner[1])) return false;
+                if (p < end && *p == '/')
+                {
+                    p++;
+                    if (!parseIndex(p, end, seen.normals, corner[2])) return false;
+                }
+            }
+
+            if (cornerCount == 0) std::copy_n(corner, 3, first);
+            if (cornerCount >= 2)
+            {
+                corners.insert(corners.end(), first, first + 3);
+                corners.insert(corners.end(), previous, previous + 3);
+                corners.insert(corners.end(), corner, corner + 3);
+            }
+            std::copy_n(corner, 3, previous);
+            cornerCount++;
+        }
+        return cornerCount >= 3;
+    }
+
+    void countObjChunk(ObjChunk& chunk)
+    {
+        for (const char* line = chunk.begin; line < chunk.end; )
+        {
+            const char* lineEnd = findLineEnd(line, chunk.end);
+            switch (classifyLine(line, lineEnd))
+            {
+                case ObjLine::Position: chunk.counts.positions++; break;
+                case ObjLine::Normal: chunk.counts.normals++; break;
+                case ObjLine::TexCoord: chunk.counts.texCoords++; break;
+                default: break;
+            }
+            line = lineEnd + 1;
+        }
+    }
+
+    bool parseObjChunk(ObjChunk& chunk, float* positions, float* normals, float* texCoords)
+    {
+        ObjCounts seen = chunk.base;
+        for (const char* line = chunk.begin; line < chunk.end; )
+        {
+            const char* lineEnd = findLineEnd(line, chunk.end);
+            switch (classifyLine(line, lineEnd))
+            {
+                case ObjLine::Position:
+                    if (parseFloats(line, lineEnd, positions + seen.positions++ * 3, 3) != 3) return false;
+                    break;
+                case ObjLine::Normal:
+                    if (parseFloats(line, lineEnd, normals + seen.normals++ * 3, 3) != 3) return false;
+                    break;
+                case ObjLine::TexCoord:
+                    // v is optional (and w ignored)
+                    if (parseFloats(line, lineEnd, texCoords + seen.texCoords++ * 2, 2) == 0) return false;
+                    break;
+                case ObjLine::Face:
+                    if (!parseFace(line, lineEnd, seen, chunk.corners)) return false;
+                    break;
+                case ObjLine::Other:
+                    break;
+            }
+            line = lineEnd + 1;
+        }
+        return true;
+    }
+
+    // --- PLY ---
+
+    enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+    struct PlyProperty
+    {
+        std::string name;
+        PlyType type;
+        bool list = false;
+        PlyType countType = PlyType::UInt8;     // Lists only: type of the leading item count
+        unsigned int offset = 0;                // Within the record, for fixed-size elements
+    };
+
+    struct PlyElement
+    {
+        std::string name;
+        size_t count = 0;
+        std::vector<PlyProperty> properties;
+        unsigned int stride = 0;                // Record size, or 0 if the element has lists
+
+        const PlyProperty* find(std::string_view property) const
+        {
+            for (const PlyProperty& candidate : properties)
+                if (candidate.name == property) return &candidate;
+            return nullptr;
+        }
+    };
+
+    bool parsePlyType(std::string_view name, PlyType& type)
+    {
+        static const std::pair<std::string_view, PlyType> names[] = {
+                {"char", PlyType::Int8}, {"int8", PlyType::Int8},
+                {"uchar", PlyType::UInt8}, {"uint8", PlyType::UInt8},
+                {"short", PlyType::Int16}, {"int16", PlyType::Int16},
+                {"ushort", PlyType::UInt16}, {"uint16", PlyType::UInt16},
+                {"int", PlyType::Int32}, {"int32", PlyType::Int32},
+                {"uint", PlyType::UInt32}, {"uint32", PlyType::UInt32},
+                {"float", PlyType::Float32}, {"float32", PlyType::Float32},
+                {"double", PlyType::Float64}, {"float64", PlyType::Float64}
+        };
+
+        for (const auto& [candidate, candidateType] : names)
+        {
+            if (candidate != name) continue;
+            type = candidateType;
+            return true;
+        }
+        return false;
+    }
+
+    unsigned int plyTypeSize(PlyType type)
+    {
+        switch (type)
+        {
+            case PlyType::Int8: case PlyType::UInt8: return 1;
+            case PlyType::Int16: case PlyType::UInt16: return 2;
+            case PlyType::Int32: case PlyType::UInt32: case PlyType::Float32: return 4;
+            case PlyType::Float64: return 8;
+        }
+        return 0;
+    }
+
+    template<typename Integer>
+    Integer loadInteger(const unsigned char* data, bool swap)
+    {
+        Integer value;
+        std::memcpy(&value, data, sizeof(value));
+        return swap ? std::byteswap(value) : value;
+    }
+
+    double readPlyValue(const unsigned char* data, PlyType type, bool swap)
+    {
+        switch (type)
+        {
+            case PlyType::Int8: return (int8_t) data[0];
+            case PlyType::UInt8: return data[0];
+            case PlyType::Int16: return (int16_t) loadInteger<uint16_t>(data, swap);
+            case PlyType::UInt16: return loadInteger<uint16_t>(data, swap);
+            case PlyType::Int32: return (int32_t) loadInteger<uint32_t>(data, swap);
+            case PlyType::UInt32: return loadInteger<uint32_t>(data, swap);
+            case PlyType::Float32: return std::bit_cast<float>(loadInteger<uint32_t>(data, swap));
+            case PlyType::Float64: return std::bit_cast<double>(loadInteger<uint64_t>(data, swap));
+        }
+        return 0.0;
+    }
+
+    // Whitespace-separated words of one header line
+    std::vector<std::string_view> splitWords(std::string_view line)
+    {
+        std::vector<std::string_view> words;
+        size_t start = 0;
+        while (true)
+        {
+            start = line.find_first_not_of(" \t\r", start);
+            if (start == std::string_view::npos) return words;
+            size_t stop = std::min(line.find_first_of(" \t\r", start), line.size());
+            words.push_back(line.substr(start, stop - start));
+            start = stop;
+        }
+    }
+
+    // Fills elements and returns the offset of the binary body, or 0 on error
+    size_t parsePlyHeader(const char* path, std::string_view text, std::vector<PlyElement>& elements, bool& bigEndian)
+    {
+        if (!text.starts_with("ply\n") && !text.starts_with("ply\r\n"))
+        {
+            std::cout << path << " is not a PLY file\n";
+            return 0;
+        }
+
+        bool binary = false;
+        for (size_t line = text.find('\n') + 1; line < text.size(); )
+        {
+            size_t lineEnd = text.find('\n', line);
+            if (lineEnd == std::string_view::npos) break;
+            std::vector<std::string_view> words = splitWords(text.substr(line, lineEnd - line));
+            line = lineEnd + 1;
+            if (words.empty() || words[0] == "comment" || words[0] == "obj_info") continue;
+
+            if (words[0] == "end_header")
+            {
+                if (binary) return line;
+                std::cout << path << ": only binary PLY files are supported\n";
+                return 0;
+            }
+
+            bool valid = true;
+            if (words[0] == "format" && words.size() >= 2)
+            {
+                binary = words[1] != "ascii";
+                bigEndian = words[1] == "binary_big_endian";
+            }
+            else if (words[0] == "element" && words.size() == 3)
+            {
+                PlyElement& element = elements.emplace_back();
+                element.name = words[1];
+                valid = std::from_chars(words[2].data(), words[2].data() + words[2].size(), element.count).ec == std::errc();
+            }
+            else if (words[0] == "property" && !elements.empty())
+            {
+                PlyProperty property;
+                if (words.size() == 5 && words[1] == "list")
+                {
+                    property.list = true;
+                    property.name = words[4];
+                    valid = parsePlyType(words[2], property.countType) && parsePlyType(words[3], property.type);
+                }
+                else if (words.size() == 3)
+                {
+                    property.name = words[2];
+                    valid = parsePlyType(words[1], property.type);
+                }
+                else valid = false;
+                elements.back().properties.push_back(property);
+            }
+            else valid = false;
+
+            if (!valid)
+            {
+                std::cout << path << ": unsupported PLY header line\n";
+                return 0;
+            }
+        }
+
+        std::cout << path << ": PLY header has no end_header\n";
+        return 0;
+    }
+
+    // Reads a list's length and advances record to its first entry; false for negative lengths or
+    // lists that run past end. Sizes are compared by division, so no pointer ever lands past end
+    bool readPlyListCount(const PlyProperty& property, const unsigned char*& record, const unsigned char* end,
+                          bool swap, size_t& count)
+    {
+        size_t countSize = plyTypeSize(property.countType);
+        if (countSize > (size_t) (end - record)) return false;
+        double value = readPlyValue(record, property.countType, swap);
+        record += countSize;
+
+        // Also rejects NaN, before the conversion (undefined for those and for negative values)
+        if (!(value >= 0.0 && value <= (double) ((size_t) (end - record) / plyTypeSize(property.type)))) return false;
+        count = (size_t) value;
+        return true;
+    }
+
+    // Advances record past one property of one record; false if it runs past end
+    bool skipPlyProperty(const PlyProperty& property, const unsigned char*& record, const unsigned char* end, bool swap)
+    {
+        if (!property.list)
+        {
+            if (plyTypeSize(property.type) > (size_t) (end - record)) return false;
+            record += plyTypeSize(property.type);
+            return true;
+        }
+
+        size_t count;
+        if (!readPlyListCount(property, record, end, swap, count)) return false;
+        record += count * plyTypeSize(property.type);
+        return true;
+    }
+
+    bool skipPlyRecord(const PlyElement& element, const unsigned char*& record, const unsigned char* end, bool swap)
+    {
+        for (const PlyProperty& property : element.properties)
+            if (!skipPlyProperty(property, record, end, swap)) return false;
+        return true;
+    }
+
+    bool readPlyVertices(const PlyElement& element, const unsigned char* body, bool swap, unsigned int threads,
+                         ModelData& model)
+    {
+        const PlyProperty* position[3] = {element.find("x"), element.find("y"), element.find("z")};
+        const PlyProperty* normal[3] = {element.find("nx"), element.find("ny"), element.find("nz")};
+        const PlyProperty* texCoord[2] = {element.find("u"), element.find("v")};
+        if (texCoord[0] == nullptr) texCoord[0] = element.find("s"), texCoord[1] = element.find("t");
+        if (texCoord[0] == nullptr) texCoord[0] = element.find("texture_u"), texCoord[1] = element.find("texture_v");
+
+        if (position[0] == nullptr || position[1] == nullptr || position[2] == nullptr || element.stride == 0)
+            return false;
+
+        model.hasNormals = normal[0] != nullptr && normal[1] != nullptr && normal[2] != nullptr;
+        model.hasTexCoords = texCoord[0] != nullptr && texCoord[1] != nullptr;
+        model.layout = modelLayout(model.hasNormals, model.hasTexCoords);
+        model.vertexCount = (unsigned int) element.count;
+
+        // Gather every attribute into one list so the per-vertex loop stays branch-light
+        std::vector<const PlyProperty*> sources(position, position + 3);
+        if (model.hasNormals) sources.insert(sources.end(), normal, normal + 3);
+        if (model.hasTexCoords) sources.insert(sources.end(), texCoord, texCoord + 2);
+
+        size_t floatsPerVertex = sources.size();
+        model.vertices.resize(element.count * floatsPerVertex);
+
+        size_t parts = partCount(threads, element.count, 65536);
+        runParallel(parts, [&](size_t part)
+        {
+            auto [first, last] = partRange(element.count, parts, part);
+            for (size_t vertex = first; vertex < last; vertex++)
+            {
+                const unsigned char* record = body + vertex * element.stride;
+                float* destination = model.vertices.data() + vertex * floatsPerVertex;
+                for (size_t i = 0; i < floatsPerVertex; i++)
+                    destination[i] = (float) readPlyValue(record + sources[i]->offset, sources[i]->type, swap);
+            }
+        });
+        return true;
+    }
+
+    // Returns the end of the face element, or nullptr if it is malformed
+    const unsigned char* readPlyFaces(const PlyElement& element, const unsigned char* body, const unsigned char* end,
+                                      bool swap, unsigned int threads, ModelData& model)
+    {
+        const PlyProperty* list = element.find("vertex_indices");
+        if (list == nullptr) list = element.find("vertex_index");
+        if (list == nullptr || !list->list) return nullptr;
+
+        // Fast path: faces holding nothing but a triangle index list are fixed-size records
+        unsigned int countSize = plyTypeSize(list->countType), indexSize = plyTypeSize(list->type);
+        size_t triangleStride = countSize + 3 * indexSize;
+        // Counts come from the header, so compare by division; a product could wrap
+        if (element.properties.size() == 1 && element.count <= (size_t) (end - body) / triangleStride)
+        {
+            model.indices.resize(element.count * 3);
+            std::atomic<bool> triangles = true;
+
+            size_t parts = partCount(threads, element.count, 65536);
+            runParallel(parts, [&](size_t part)
+            {
+                auto [first, last] = partRange(element.count, parts, part);
+                for (size_t face = first; face < last && triangles.load(std::memory_order_relaxed); face++)
+                {
+                    const unsigned char* record = body + face * triangleStride;
+                    if (readPlyValue(record, list->countType, swap) != 3.0)
+                    {
+                        triangles = false;
+                        return;
+                    }
+                    for (int corner = 0; corner < 3; corner++)
+                    {
+                        double index = readPlyValue(record + countSize + corner * indexSize, list->type, swap);
+                        model.indices[face * 3 + corner] = index < 0.0 ? noIndex : (uint32_t) index;
+                    }
+                }
+            });
+
+            if (triangles) return body + element.count * triangleStride;
+            model.indices.clear();
+        }
+
+        // Polygons or extra properties: walk the records in order and split polygons into fans
+        const unsigned char* record = body;
+        for (size_t face = 0; face < element.count; face++)
+        {
+            for (const PlyProperty& property : element.properties)
+            {
+                if (&property != list)
+                {
+                    if (!skipPlyProperty(property, record, end, swap)) return nullptr;
+                    continue;
+                }
+
+                size_t count;
+                if (!readPlyListCount(*list, record, end, swap, count)) return nullptr;
+
+                auto index = [&](size_t corner)
+                {
+                    double value = readPlyValue(record + corner * indexSize, list->type, swap);
+                    return value < 0.0 ? noIndex : (uint32_t) value;
+                };
+                for (size_t corner = 2; corner < count; corner++)
+                {
+                    model.indices.push_back(index(0));
+                    model.indices.push_back(index(corner - 1));
+                    model.indices.push_back(index(corner));
+                }
+                record += count * indexSize;
+            }
+        }
+        return record;
+    }
+}
+
+bool ModelLoader::loadOBJ(const char* path, ModelData& model, unsigned int threads)
+{
+    TRACE_SCOPE("ModelLoader::loadOBJ");
+
+    MappedFile file;
+    if (!file.open(path)) return false;
+
+    // Split into chunks of whole lines
+    auto text = (const char*) file.data();
+    const char* textEnd = text + file.size();
+    size_t parts = partCount(threads, file.size(), 1 << 20);
+
+    std::vector<ObjChunk> chunks(parts);
+    const char* chunkBegin = text;
+    for (size_t part = 0; part < parts; part++)
+    {
+        const char* chunkEnd = part + 1 == parts ? textEnd : text + file.size() * (part + 1) / parts;
+        if (chunkEnd < chunkBegin) chunkEnd = chunkBegin;
+        if (chunkEnd < textEnd) chunkEnd = std::min(findLineEnd(chunkEnd, textEnd) + 1, textEnd);
+
+        chunks[part].begin = chunkBegin;
+        chunks[part].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    // Pass 1: where each chunk's attributes start in the shared arrays
+    runParallel(parts, [&](size_t part) { countObjChunk(chunks[part]); });
+
+    ObjCounts total;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.base = total;
+        total.positions += chunk.counts.positions;
+        total.normals += chunk.counts.normals;
+        total.texCoords += chunk.counts.texCoords;
+    }
+
+    // Pass 2: attributes straight into place, faces into per-chunk corner lists
+    std::vector<float> positions(total.positions * 3), normals(total.normals * 3), texCoords(total.texCoords * 2);
+    std::atomic<bool> parsed = true;
+    runParallel(parts, [&](size_t part)
+    {
+        if (!parseObjChunk(chunks[part], positions.data(), normals.data(), texCoords.data())) parsed = false;
+    });
+
+    if (!parsed)
+    {
+        std::cout << path << ": malformed vertex or face line\n";
+        return false;
+    }
+
+    // Pass 3: one vertex per corner, then weld identical corners back into shared vertices
+    std::vector<size_t> cornerBase(parts + 1, 0);
+    for (size_t part = 0; part < parts; part++) cornerBase[part + 1] = cornerBase[part] + chunks[part].corners.size() / 3;
+
+    size_t cornerCount = cornerBase[parts];
+    if (cornerCount == 0 || cornerCount >= noIndex)
+    {
+        std::cout << path << (cornerCount == 0 ? ": no faces\n" : ": too many faces\n");
+        return false;
+    }
+
+    model.hasNormals = total.normals != 0;
+    model.hasTexCoords = total.texCoords != 0;
+    model.layout = modelLayout(model.hasNormals, model.hasTexCoords);
+
+    size_t floatsPerVertex = model.layout.getStride() / sizeof(float);
+    model.vertices.assign(cornerCount * floatsPerVertex, 0.0f);
+
+    std::atomic<bool> inRange = true;
+    runParallel(parts, [&](size_t part)
+    {
+        const std::vector<uint32_t>& corners = chunks[part].corners;
+        float* destination = model.vertices.data() + cornerBase[part] * floatsPerVertex;
+        for (size_t corner = 0; corner < corners.size(); corner += 3, destination += floatsPerVertex)
+        {
+            uint32_t position = corners[corner], texCoord = corners[corner + 1], normal = corners[corner + 2];
+            if (position >= total.positions || (texCoord != noIndex && texCoord >= total.texCoords) ||
+                (normal != noIndex && normal >= total.normals))
+            {
+                inRange = false;
+                return;
+            }
+
+            float* attribute = destination;
+            std::copy_n(&positions[position * 3], 3, attribute);
+            attribute += 3;
+            if (model.hasNormals)
+            {
+                if (normal != noIndex) std::copy_n(&normals[normal * 3], 3, attribute);
+                attribute += 3;
+            }
+            if (model.hasTexCoords && texCoord != noIndex) std::copy_n(&texCoords[texCoord * 2], 2, attribute);
+        }
+    });
+
+    if (!inRange)
+    {
+        std::cout << path << ": face refers to a missing vertex\n";
+        return false;
+    }
+
+    model.indices.resize(cornerCount);
+    std::iota(model.indices.begin(), model.indices.end(), 0u);
+    model.vertexCount = (unsigned int) VertexWelder::weld(model.vertices.data(), model.layout.getStride(), cornerCount,
+                                                          model.indices.data(), cornerCount);
+    model.vertices.resize(model.vertexCount * floatsPerVertex);
+    return true;
+}
+
+bool ModelLoader::loadPLY(const char* path, ModelData& model, unsigned int threads)
+{
+    TRACE_SCOPE("ModelLoader::loadPLY");
+
+    MappedFile file;
+    if (!file.open(path)) return false;
+
+    // The header is ASCII and ends within the first few kilobytes
+    std::string_view header((const char*) file.data(), std::min<size_t>(file.size(), 1 << 16));
+    std::vector<PlyElement> elements;
+    bool bigEndian = false;
+    size_t bodyOffset = parsePlyHeader(path, header, elements, bigEndian);
+    if (bodyOffset == 0) return false;
+
+    bool swap = bigEndian != (std::endian::native == std::endian::big);
+    for (PlyElement& element : elements)
+    {
+        for (PlyProperty& property : element.properties)
+        {
+            if (property.list)
+            {
+                element.stride = 0;
+                break;
+            }
+            property.offset = element.stride;
+            element.stride += plyTypeSize(property.type);
+        }
+    }
+
+    const unsigned char* end = file.data() + file.size();
+    const unsigned char* body = file.data() + bodyOffset;
+    bool foundVertices = false;
+    for (const PlyElement& element : elements)
+    {
+        if (element.name == "face")
+        {
+            body = readPlyFaces(element, body, end, swap, threads, model);
+            if (body == nullptr)
+            {
+                std::cout << path << ": malformed or unsupported face element\n";
+                return false;
+            }
+            continue;
+        }
+
+        if (element.name == "vertex")
+        {
+            if (element.stride == 0 || element.count > (size_t) (end - body) / element.stride ||
+                element.count >= noIndex || !readPlyVertices(element, body, swap, threads, model))
+            {
+                std::cout << path << ": malformed or unsupported vertex element\n";
+                return false;
+            }
+            foundVertices = true;
+        }
+
+        // Everything else (edges, materials, ...) is skipped; elements without properties take no space
+        if (element.properties.empty()) continue;
+        if (element.stride != 0)
+        {
+            if (element.count > (size_t) (end - body) / element.stride)
+            {
+                std::cout << path << ": truncated " << element.name << " element\n";
+                return false;
+            }
+            body += element.count * element.stride;
+            continue;
+        }
+        for (size_t record = 0; record < element.count; record++)
+        {
+            if (!skipPlyRecord(element, body, end, swap))
+            {
+                std::cout << path << ": truncated " << element.name << " element\n";
+                return false;
+            }
+        }
+    }
+
+    if (!foundVertices || model.indices.empty())
+    {
+        std::cout << path << ": needs both vertex and face elements\n";
+        return false;
+    }
+
+    // Faces may come before vertices, so indices are only checked once both are read
+    if (*std::max_element(model.indices.begin(), model.indices.end()) >= model.vertexCount)
+    {
+        std::cout << path << ": face refers to a missing vertex\n";
+        return false;
+    }
+    return true;
+}
+
+bool ModelLoader::load(const char* path, ModelData& model, unsigned int threads)
+{
+    std::string extension(path);
+    extension = extension.substr(std::min(extension.rfind('.'), extension.size()));
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    if (extension == ".obj") return loadOBJ(path, model, threads);
+    if (extension == ".ply") return loadPLY(path, model, threads);
+
+    std::cout << "Unknown model format for " << path << " (expected .obj or .ply)\n";
+    return false;
+}
+
+ImportedModel ModelLoader::createMesh(ModelData& model, const ModelImportOptions& options)
+{
+    TRACE_SCOPE("ModelLoader::createMesh");
+
+    unsigned int stride = model.layout.getStride();
+    size_t floatsPerVertex = stride / sizeof(float);
+    size_t vertexCount = model.vertexCount;
+
+    if (options.weldEpsilon > 0.0f)
+        vertexCount = VertexWelder::weld(model.vertices.data(), stride, vertexCount, model.indices.data(),
+                                         model.indices.size(), 0, options.weldEpsilon);
+
+    ImportedModel result;
+    if (options.optimize)
+        vertexCount = MeshOptimizer::optimize(model.vertices.data(), stride, 0, model.indices.data(),
+                                              model.indices.size(), vertexCount, &result.cacheBefore,
+                                              &result.cacheAfter);
+
+    model.vertexCount = (unsigned int) vertexCount;
+    model.vertices.resize(vertexCount * floatsPerVertex);
+
+    result.mesh = std::make_shared<Mesh>();
+    result.vertexCount = model.vertexCount;
+    result.indexCount = (unsigned int) model.indices.size();
+
+    if (!options.quantize)
+    {
+        result.mesh->create(model.vertices.data(), model.vertexCount, model.indices.data(), result.indexCount,
+                            model.layout);
+        return result;
+    }
+
+    // VertexQuantizer takes separate streams
+    std::vector<glm::vec3> positions(vertexCount), normals(model.hasNormals ? vertexCount : 0);
+    std::vector<glm::vec2> texCoords(model.hasTexCoords ? vertexCount : 0);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++)
+    {
+        const float* source = model.vertices.data() + vertex * floatsPerVertex;
+        positions[vertex] = glm::vec3(source[0], source[1], source[2]);
+        source += 3;
+        if (model.hasNormals)
+        {
+            normals[vertex] = glm::vec3(source[0], source[1], source[2]);
+            source += 3;
+        }
+        if (model.hasTexCoords) texCoords[vertex] = glm::vec2(source[0], source[1]);
+    }
+
+    QuantizedVertices quantized = VertexQuantizer::quantize(positions.data(),
+                                                            model.hasNormals ? normals.data() : nullptr,
+                                                            model.hasTexCoords ? texCoords.data() : nullptr,
+                                                            model.vertexCount, options.positionEncoding);
+    result.mesh->create(quantized.data.data(), quantized.vertexCount, model.indices.data(), result.indexCount,
+                        quantized.layout);
+    result.positionTransform = quantized.positionTransform;
+    result.texCoordTransform = quantized.texCoordTransform;
+    return result;
+}
+
+bool ModelLoader::import(const char* path, ImportedModel& result, const ModelImportOptions& options)
+{
+    ModelData model;
+    if (!load(path, model, options.threads)) return false;
+
+    result = createMesh(model, options);
+    return true;
+}
@@ -0,0 +1,76 @@
+//
+// OBJ and PLY model loading
+//
+
+#pragma once
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "meshoptimizer.h"
+#include "vertexlayout.h"
+#include "vertexquantizer.h"
+
+// Indexed triangles in interleaved floats: position, then normal and UV when the file has them
+struct ModelData
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    unsigned int vertexCount = 0;
+    VertexLayout layout;
+    bool hasNormals = false, hasTexCoords = false;
+};
+
+struct ModelImportOptions
+{
+    unsigned int threads = 0;       // Parser threads (0 = one per core)
+    float weldEpsilon = 0.0f;       // Also weld positions this close (see VertexWelder); 0 keeps exact matches only
+    bool optimize = true;           // Reorder for the vertex cache, overdraw and fetch (see MeshOptimizer)
+    bool quantize = false;          // Compress with VertexQuantizer; draw with Shaders/quantized.vertex
+    PositionEncoding positionEncoding = PositionEncoding::Snorm16;
+};
+
+struct ImportedModel
+{
+    std::shared_ptr<Mesh> mesh;
+    unsigned int vertexCount = 0, indexCount = 0;
+
+    // Vertex cache efficiency of the index order as loaded and after MeshOptimizer (zero unless optimized)
+    VertexCacheStats cacheBefore, cacheAfter;
+
+    // Identity unless quantized: fold into the model matrix and the uvTransform uniform
+    glm::mat4 positionTransform {1.0f};
+    glm::vec4 texCoordTransform {0.0f, 0.0f, 1.0f, 1.0f};
+};
+
+/* Loads Wavefront OBJ and binary PLY files through a memory mapping and parses them on several
+ * threads:
+ *
+ *   OBJ: the file is split into line-aligned chunks. A first pass counts v/vt/vn lines per chunk
+ *        so every chunk knows where its attributes land (and what negative indices refer to); the
+ *        second parses them with std::from_chars straight into the shared arrays and collects
+ *        faces, which are then expanded into one vertex per corner and welded back together.
+ *   PLY: vertices are fixed-size records, so each thread converts its own range. Faces are too
+ *        when every face is a triangle (the common case); otherwise they are walked in order.
+ *
+ *     ImportedModel model;
+ *     if (ModelLoader::import("scan.ply", model)) meshes.emplace_back(model.mesh);
+ */
+class ModelLoader
+{
+public:
+    ModelLoader() = delete;
+
+    static bool loadOBJ(const char* path, ModelData& model, unsigned int threads = 0);
+    static bool loadPLY(const char* path, ModelData& model, unsigned int threads = 0);
+
+    // Picks the parser from the file extension
+    static bool load(const char* path, ModelData& model, unsigned int threads = 0);
+
+    // Welds, optimizes and quantizes as requested (modifying model), then uploads it into a Mesh
+    static ImportedModel createMesh(ModelData& model, const ModelImportOptions& options = {});
+
+    // load() followed by createMesh()
+    static bool import(const char* path, ImportedModel& result, const ModelImportOptions& options = {});
+};
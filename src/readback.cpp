@@ -0,0 +1,93 @@
+//
+// Asynchronous framebuffer readback through a pixel pack buffer
+//
+
+#include "readback.h"
+#include "statecache.h"
+
+PixelReadback::PixelReadback() : m_PBO(0), m_Fence(nullptr), m_Width(0), m_Height(0), m_Mapped(false)
+{}
+
+PixelReadback::~PixelReadback()
+{
+    clear();
+}
+
+void PixelReadback::create(unsigned int width, unsigned int height)
+{
+    m_Width = width;
+    m_Height = height;
+
+    if (m_PBO == 0) glGenBuffers(1, &m_PBO);
+    GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, m_PBO);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr) getSize(), nullptr, GL_STREAM_READ);
+    GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void PixelReadback::begin()
+{
+    if (m_Fence != nullptr) glDeleteSync(m_Fence);
+
+    // With a pack buffer bound the pointer argument is an offset, and the call doesn't wait for the GPU
+    GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, m_PBO);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, (GLsizei) m_Width, (GLsizei) m_Height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    // Unbind so other glReadPixels calls keep writing to client memory
+    GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+}
+
+bool PixelReadback::isReady()
+{
+    if (m_Fence == nullptr) return false;
+
+    GLenum result = glClientWaitSync(m_Fence, 0, 0);
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+const unsigned char* PixelReadback::map()
+{
+    if (m_Fence == nullptr) return nullptr;
+
+    glClientWaitSync(m_Fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(m_Fence);
+    m_Fence = nullptr;
+
+    GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, m_PBO);
+    auto rows = (const unsigned char*) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr) getSize(), GL_MAP_READ_BIT);
+    GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_Mapped = rows != nullptr;
+    return rows;
+}
+
+void PixelReadback::unmap()
+{
+    if (!m_Mapped) return;
+
+    GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, m_PBO);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    m_Mapped = false;
+}
+
+void PixelReadback::clear()
+{
+    unmap();
+
+    if (m_Fence != nullptr)
+    {
+        glDeleteSync(m_Fence);
+        m_Fence = nullptr;
+    }
+
+    if (m_PBO != 0)
+    {
+        GLStateCache::forgetBuffer(m_PBO);
+        glDeleteBuffers(1, &m_PBO);
+        m_PBO = 0;
+    }
+}
@@ -0,0 +1,48 @@
+//
+// Asynchronous framebuffer readback through a pixel pack buffer
+//
+
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+
+/* Copies the bound read framebuffer into a pixel pack buffer instead of client memory, so
+ * glReadPixels returns immediately and the copy happens in order with the rest of the GPU work.
+ * A fence marks when it has landed; map() only blocks if it hasn't yet.
+ *
+ *     readback.begin();
+ *     ... keep rendering ...
+ *     if (readback.isReady()) { const unsigned char* rows = readback.map(); ...; readback.unmap(); }
+ */
+class PixelReadback
+{
+public:
+    PixelReadback();
+    ~PixelReadback();
+
+    PixelReadback(const PixelReadback&) = delete;
+    PixelReadback& operator=(const PixelReadback&) = delete;
+private:
+    unsigned int m_PBO;
+    GLsync m_Fence;
+    unsigned int m_Width, m_Height;
+    bool m_Mapped;
+public:
+    // Sizes the buffer for RGBA8 pixels
+    void create(unsigned int width, unsigned int height);
+
+    // Queues a read of the bound GL_READ_FRAMEBUFFER's colour attachment 0 (or back buffer)
+    void begin();
+
+    constexpr bool isPending() const { return m_Fence != nullptr; }
+    bool isReady();
+
+    // Bottom-up RGBA8 rows, valid until unmap(); waits for the copy if it is still in flight
+    const unsigned char* map();
+    void unmap();
+    void clear();
+
+    constexpr unsigned int getWidth() const { return m_Width; }
+    constexpr unsigned int getHeight() const { return m_Height; }
+    constexpr size_t getSize() const { return (size_t) m_Width * m_Height * 4; }
+};
@@ -0,0 +1,156 @@
+//
+// Sorted draw submission
+//
+
+#include "renderqueue.h"
+#include "statecache.h"
+
+#include <bit>
+#include <cstring>
+
+namespace
+{
+    constexpr int shaderBits = 12, meshBits = 16, materialBits = 11, depthBits = 24;
+
+    constexpr uint64_t mask(int bits)
+    {
+        return (uint64_t(1) << bits) - 1;
+    }
+
+    // Non-negative floats order the same as their bit patterns; keep the top bits below the sign
+    uint64_t quantizeDepth(float depth)
+    {
+        if (!(depth > 0.0f)) return 0;
+        return std::bit_cast<uint32_t>(depth) >> (31 - depthBits);
+    }
+}
+
+uint64_t RenderQueue::makeKey(const DrawPacket& packet)
+{
+    uint64_t shader = packet.shader->getID() & mask(shaderBits);
+    uint64_t mesh = packet.mesh->getVAO() & mask(meshBits);
+    uint64_t material = packet.material & mask(materialBits);
+    uint64_t depth = quantizeDepth(packet.depth);
+
+    if (!packet.transparent)
+    {
+        return shader << (meshBits + materialBits + depthBits)
+               | mesh << (materialBits + depthBits)
+               | material << depthBits
+               | depth;
+    }
+
+    // Farthest first, so the inverted depth leads
+    return uint64_t(1) << 63
+           | (~depth & mask(depthBits)) << (shaderBits + meshBits + materialBits)
+           | shader << (meshBits + materialBits)
+           | mesh << materialBits
+           | material;
+}
+
+void RenderQueue::submit(const DrawPacket& packet)
+{
+    m_Entries.push_back({ makeKey(packet), (uint32_t) m_Packets.size() });
+    m_Packets.push_back(packet);
+    m_Sorted = false;
+}
+
+void RenderQueue::sort()
+{
+    if (!m_Sorted) radixSort();
+    m_Sorted = true;
+}
+
+void RenderQueue::radixSort()
+{
+    const size_t count = m_Entries.size();
+    if (count < 2) return;
+    m_Scratch.resize(count);
+
+    // Build all eight byte histograms in a single pass over the keys
+    size_t histograms[8][256] {};
+    for (const SortEntry& entry : m_Entries)
+        for (int pass = 0; pass < 8; pass++)
+            histograms[pass][(entry.key >> (pass * 8)) & 0xFF]++;
+
+    SortEntry* source = m_Entries.data();
+    SortEntry* destination = m_Scratch.data();
+    for (int pass = 0; pass < 8; pass++)
+    {
+        size_t* histogram = histograms[pass];
+
+        // Every key has the same byte here (common for the high shader/mesh bits), so the pass is a no-op
+        if (histogram[(source[0].key >> (pass * 8)) & 0xFF] == count) continue;
+
+        size_t offset = 0;
+        for (int bucket = 0; bucket < 256; bucket++)
+        {
+            size_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+
+        for (size_t i = 0; i < count; i++)
+            destination[histogram[(source[i].key >> (pass * 8)) & 0xFF]++] = source[i];
+
+        std::swap(source, destination);
+    }
+
+    if (source != m_Entries.data()) std::memcpy(m_Entries.data(), source, sizeof(SortEntry) * count);
+}
+
+void RenderQueue::dispatch(UniformBuffer& uniforms)
+{
+    sort();
+    if (m_Entries.empty()) return;
+
+    // Upload every transform up front, in draw order
+    unsigned int firstObject = uniforms.beginObjects((unsigned int) m_Entries.size());
+    for (size_t i = 0; i < m_Entries.size(); i++)
+    {
+        ObjectUniforms object;
+        object.model = m_Packets[m_Entries[i].index].transform;
+        uniforms.setObject(firstObject + (unsigned int) i, object);
+    }
+    uniforms.endObjects();
+
+    Shader* currentShader = nullptr;
+    bool blending = false;
+
+    for (size_t i = 0; i < m_Entries.size(); i++)
+    {
+        const SortEntry& entry = m_Entries[i];
+        const DrawPacket& packet = m_Packets[entry.index];
+
+        // Transparent draws come last; they blend and test depth without writing it
+        if (packet.transparent && !blending)
+        {
+            GLStateCache::enable(GL_BLEND);
+            GLStateCache::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            GLStateCache::depthMask(false);
+            blending = true;
+        }
+
+        if (packet.shader != currentShader)
+        {
+            currentShader = packet.shader;
+            currentShader->use();
+        }
+
+        uniforms.bindObject(firstObject + (unsigned int) i);
+        packet.mesh->render();
+    }
+
+    if (blending)
+    {
+        GLStateCache::depthMask(true);
+        GLStateCache::disable(GL_BLEND);
+    }
+}
+
+void RenderQueue::clear()
+{
+    m_Packets.clear();
+    m_Entries.clear();
+    m_Sorted = false;
+}
@@ -0,0 +1,60 @@
+//
+// Sorted draw submission
+//
+
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "shader.h"
+#include "uniformbuffer.h"
+
+struct DrawPacket
+{
+    Mesh* mesh = nullptr;
+    Shader* shader = nullptr;
+    unsigned int material = 0;      // Only used to group draws that share material state
+    glm::mat4 transform {1.0f};
+    float depth = 0.0f;             // Distance from the camera
+    bool transparent = false;
+};
+
+/* Collects draw packets for a frame, encodes each as a 64-bit sort key and radix-sorts them so
+ * opaque draws are grouped by program, then VAO, then material (front-to-back within a group),
+ * followed by transparent draws back-to-front.
+ *
+ * Key layout, most significant bit first:
+ *     opaque:      0 | shader:12 | mesh:16 | material:11 | depth:24
+ *     transparent: 1 | ~depth:24 | shader:12 | mesh:16 | material:11
+ */
+class RenderQueue
+{
+public:
+    RenderQueue() = default;
+    ~RenderQueue() = default;
+private:
+    struct SortEntry
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    std::vector<DrawPacket> m_Packets;
+    std::vector<SortEntry> m_Entries, m_Scratch;
+    bool m_Sorted = false;
+private:
+    static uint64_t makeKey(const DrawPacket& packet);
+    void radixSort();
+public:
+    void submit(const DrawPacket& packet);
+    void sort();
+
+    // Draws everything in key order, changing program and VAO only when the key says so.
+    // Transforms go into per-object blocks of the given UniformBuffer, written in one batch.
+    void dispatch(UniformBuffer& uniforms);
+    void clear();
+
+    size_t size() const { return m_Packets.size(); }
+};
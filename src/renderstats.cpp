@@ -0,0 +1,8 @@
+//
+// Per-frame draw call and upload counters
+//
+
+#include "renderstats.h"
+
+unsigned long long RenderStats::s_DrawCalls = 0;
+unsigned long long RenderStats::s_BytesUploaded = 0;
@@ -0,0 +1,22 @@
+//
+// Per-frame draw call and upload counters
+//
+
+#pragma once
+#include <cstddef>
+
+// Counted on the GL thread by Mesh, MeshPool and UniformBuffer; read and reset by the benchmark
+class RenderStats
+{
+public:
+    RenderStats() = delete;
+private:
+    static unsigned long long s_DrawCalls, s_BytesUploaded;
+public:
+    static void countDraw() { s_DrawCalls++; }
+    static void countUpload(size_t bytes) { s_BytesUploaded += bytes; }
+
+    static unsigned long long getDrawCalls() { return s_DrawCalls; }
+    static unsigned long long getBytesUploaded() { return s_BytesUploaded; }
+    static void reset() { s_DrawCalls = s_BytesUploaded = 0; }
+};
@@ -0,0 +1,84 @@
+//
+// Fixed-timestep frame scheduling
+//
+
+#include "scheduler.h"
+
+#include <thread>
+
+namespace
+{
+    // The OS sleep granularity; anything closer to the deadline than this is spun out
+    constexpr auto spinThreshold = std::chrono::milliseconds(2);
+
+    FrameScheduler::Clock::duration period(double rate)
+    {
+        return std::chrono::duration_cast<FrameScheduler::Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+    }
+}
+
+FrameScheduler::FrameScheduler() : FrameScheduler(60.0, 60.0, PacingMode::VSync)
+{}
+
+FrameScheduler::FrameScheduler(double updateRate, double frameRate, PacingMode mode)
+    : m_Mode(mode), m_Timestep(period(updateRate)), m_FramePeriod(period(frameRate))
+{}
+
+void FrameScheduler::beginFrame()
+{
+    Clock::time_point now = Clock::now();
+    if (!m_Started)
+    {
+        // The first frame always simulates exactly one step
+        m_Started = true;
+        m_LastFrame = now - m_Timestep;
+        m_Deadline = now;
+    }
+
+    m_FrameTime = now - m_LastFrame;
+    m_LastFrame = now;
+    m_Accumulator += m_FrameTime;
+    m_Updates = 0;
+}
+
+bool FrameScheduler::update()
+{
+    if (m_Accumulator < m_Timestep) return false;
+
+    // Drop the backlog instead of trying to catch up after a stall
+    if (m_Updates == m_MaxUpdates)
+    {
+        m_Accumulator %= m_Timestep;
+        return false;
+    }
+
+    m_Accumulator -= m_Timestep;
+    m_Updates++;
+    return true;
+}
+
+double FrameScheduler::getAlpha() const
+{
+    return std::chrono::duration<double>(m_Accumulator).count() / getTimestep();
+}
+
+void FrameScheduler::endFrame()
+{
+    if (m_Mode != PacingMode::BusyWait) return;
+
+    m_Deadline += m_FramePeriod;
+    Clock::time_point now = Clock::now();
+
+    // Missed the deadline by more than a frame: re-anchor rather than rushing the next frames
+    if (now > m_Deadline + m_FramePeriod)
+    {
+        m_Deadline = now;
+        return;
+    }
+
+    if (m_Deadline - now > spinThreshold)
+        std::this_thread::sleep_for(m_Deadline - now - spinThreshold);
+
+    while (Clock::now() < m_Deadline)
+        std::this_thread::yield();
+}
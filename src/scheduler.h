@@ -0,0 +1,51 @@
+//
+// Fixed-timestep frame scheduling
+//
+
+#pragma once
+#include <chrono>
+
+enum class PacingMode
+{
+    VSync,      // swapBuffers() blocks on the display refresh; the scheduler never waits
+    BusyWait,   // Sleep for most of the frame, then spin until the frame deadline
+    Uncapped    // Render as fast as possible
+};
+
+/* Decouples simulation from rendering: real time is accumulated every frame and consumed in
+ * fixed-size steps, and the leftover fraction is exposed as an interpolation factor.
+ *
+ *     scheduler.beginFrame();
+ *     while (scheduler.update()) simulate(scheduler.getTimestep());
+ *     render(scheduler.getAlpha());
+ *     scheduler.endFrame();
+ */
+class FrameScheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FrameScheduler();
+    FrameScheduler(double updateRate, double frameRate, PacingMode mode);
+    ~FrameScheduler() = default;
+private:
+    PacingMode m_Mode;
+    Clock::duration m_Timestep, m_FramePeriod;
+    Clock::duration m_Accumulator {}, m_FrameTime {};
+    Clock::time_point m_LastFrame, m_Deadline;
+    unsigned int m_MaxUpdates = 8, m_Updates = 0;
+    bool m_Started = false;
+public:
+    void beginFrame();
+    bool update();
+    void endFrame();
+
+    void setMode(PacingMode mode) { m_Mode = mode; }
+    // Caps simulation steps per frame so a long stall can't snowball into ever longer frames
+    void setMaxUpdates(unsigned int updates) { m_MaxUpdates = updates; }
+
+    constexpr PacingMode getMode() const { return m_Mode; }
+    double getTimestep() const { return std::chrono::duration<double>(m_Timestep).count(); }
+    double getFrameTime() const { return std::chrono::duration<double>(m_FrameTime).count(); }
+    double getAlpha() const;
+};
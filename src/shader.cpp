@@ -3,13 +3,30 @@
 //
 
 #include "shader.h"
+#include "statecache.h"
+#include "shadercache.h"
+#include "uniformbuffer.h"
+#include "trace.h"
 
 #include <iostream>
 #include <cstring>
 #include <fstream>
+#include <utility>
+#include <bit>
+#include <glm/gtc/type_ptr.hpp>
 
-void Shader::compile(const char* vertexSource, const char* fragmentSource)
+namespace
 {
+    bool supportsParallelCompile()
+    {
+        return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+    }
+}
+
+bool Shader::beginCompile(const char* vertexSource, const char* fragmentSource)
+{
+    TRACE_SCOPE("Shader::beginCompile");
+
     // Create a shader program and get ID
     m_ID = glCreateProgram();
 
@@ -17,26 +34,48 @@ void Shader::compile(const char* vertexSource, const char* fragmentSource)
     if (!m_ID)
     {
         std::cout << "Failed to create shader program\n";
-        return;
+        return false;
     }
 
-    add(m_ID, vertexSource, GL_VERTEX_SHADER);
-    add(m_ID, fragmentSource, GL_FRAGMENT_SHADER);
+    m_VertexShader = add(m_ID, vertexSource, GL_VERTEX_SHADER);
+    m_FragmentShader = add(m_ID, fragmentSource, GL_FRAGMENT_SHADER);
+
+    // Let the driver keep the linked binary around for the shader cache
+    if (m_CacheKey != 0) glProgramParameteri(m_ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
-    // Link shader program
+    // Link shader program (status is only checked in finishCompile(), so the driver can work in the background)
     glLinkProgram(m_ID);
+    m_Pending = true;
+    return true;
+}
+
+bool Shader::finishCompile()
+{
+    TRACE_SCOPE("Shader::finishCompile");
+    m_Pending = false;
 
     /* Used to check for errors */
     int result = 0;
     char errorMessage[1024] {};
 
+    // Check for compilation errors first; a failed stage also fails the link
+    bool compiled = checkCompile(m_VertexShader, GL_VERTEX_SHADER);
+    compiled = checkCompile(m_FragmentShader, GL_FRAGMENT_SHADER) && compiled;
+
+    // The linked program keeps its own copy of the code
+    glDetachShader(m_ID, m_VertexShader);
+    glDetachShader(m_ID, m_FragmentShader);
+    glDeleteShader(m_VertexShader);
+    glDeleteShader(m_FragmentShader);
+    m_VertexShader = m_FragmentShader = 0;
+
     // Check for linking errors
     glGetProgramiv(m_ID, GL_LINK_STATUS, &result);
     if (!result)
     {
         glGetProgramInfoLog(m_ID, sizeof(errorMessage), nullptr, errorMessage);
-        std::cout << "Failed to link shader program: " << errorMessage << '\n';
-        return;
+        if (compiled) std::cout << "Failed to link shader program: " << errorMessage << '\n';
+        return false;
     }
 
     // Validate shader program
@@ -48,15 +87,134 @@ void Shader::compile(const char* vertexSource, const char* fragmentSource)
     {
         glGetProgramInfoLog(m_ID, sizeof(errorMessage), nullptr, errorMessage);
         std::cout << "Failed to validate shader program: " << errorMessage << '\n';
-        return;
+        return false;
+    }
+
+    queryUniforms();
+    m_Ready = true;
+    return true;
+}
+
+void Shader::queryUniforms()
+{
+    int uniformCount = 0, maxNameLength = 0;
+    glGetProgramiv(m_ID, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(m_ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    // Power-of-two table at most half full keeps probe sequences short
+    m_Uniforms.assign(std::bit_ceil((size_t) uniformCount * 2 + 1), UniformSlot {});
+
+    std::string name(maxNameLength, '\0');
+    for (int uniform = 0; uniform < uniformCount; uniform++)
+    {
+        int length = 0, size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_ID, uniform, maxNameLength, &length, &size, &type, name.data());
+
+        // Block members have no location; they are set through UniformBuffer
+        int location = glGetUniformLocation(m_ID, name.c_str());
+        if (location < 0) continue;
+
+        // Arrays are reported as "name[0]"; register the plain name too
+        std::string uniformName(name.c_str(), length);
+        insertUniform(uniformName.c_str(), location);
+        if (uniformName.ends_with("[0]"))
+            insertUniform(uniformName.substr(0, uniformName.size() - 3).c_str(), location);
+    }
+
+    // Shared blocks are set once per frame/object by UniformBuffer rather than per program
+    UniformBuffer::bindBlocks(m_ID);
+}
+
+void Shader::insertUniform(const char* name, int location)
+{
+    uint32_t hash = UniformName::hash(name);
+    size_t mask = m_Uniforms.size() - 1;
+
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+    {
+        if (m_Uniforms[slot].hash == 0)
+        {
+            m_Uniforms[slot] = { hash, location };
+            return;
+        }
+
+        if (m_Uniforms[slot].hash == hash)
+        {
+            std::cout << "Uniform \"" << name << "\" collides with another uniform's name hash\n";
+            return;
+        }
     }
+}
 
-    // Set uniform location IDs
-    m_UniformProjection = glGetUniformLocation(m_ID, "projection");
-    m_UniformModel = glGetUniformLocation(m_ID, "model");
+int Shader::getUniformLocation(UniformName name) const
+{
+    if (m_Uniforms.empty()) return -1;
+
+    size_t mask = m_Uniforms.size() - 1;
+    for (size_t slot = name.getHash() & mask;; slot = (slot + 1) & mask)
+    {
+        const UniformSlot& entry = m_Uniforms[slot];
+        if (entry.hash == name.getHash()) return entry.location;
+        if (entry.hash == 0) return -1;
+    }
 }
 
-void Shader::add(unsigned int program, const char* source, GLenum type)
+void Shader::setUniform(UniformName name, int value)
+{
+    int location = getUniformLocation(name);
+    if (location < 0) return;
+
+    use();
+    glUniform1i(location, value);
+}
+
+void Shader::setUniform(UniformName name, float value)
+{
+    int location = getUniformLocation(name);
+    if (location < 0) return;
+
+    use();
+    glUniform1f(location, value);
+}
+
+void Shader::setUniform(UniformName name, const glm::vec2& value)
+{
+    int location = getUniformLocation(name);
+    if (location < 0) return;
+
+    use();
+    glUniform2fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setUniform(UniformName name, const glm::vec3& value)
+{
+    int location = getUniformLocation(name);
+    if (location < 0) return;
+
+    use();
+    glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setUniform(UniformName name, const glm::vec4& value)
+{
+    int location = getUniformLocation(name);
+    if (location < 0) return;
+
+    use();
+    glUniform4fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setUniform(UniformName name, const glm::mat4& value)
+{
+    int location = getUniformLocation(name);
+    if (location < 0) return;
+
+    use();
+    glUniformMatrix4fv(location, 1, false, glm::value_ptr(value));
+}
+
+unsigned int Shader::add(unsigned int program, const char* source, GLenum type)
 {
     unsigned int newShader = glCreateShader(type);
     const char* theCode[1];
@@ -73,20 +231,25 @@ void Shader::add(unsigned int program, const char* source, GLenum type)
     glShaderSource(newShader, 1, theCode, codeLength);
     glCompileShader(newShader);
 
+    // Attach new shader to the shader program
+    glAttachShader(program, newShader);
+    return newShader;
+}
+
+bool Shader::checkCompile(unsigned int shader, GLenum type)
+{
     int result = 0;
     char errorMessage[1024] = {};
 
     // Check for compilation errors
-    glGetShaderiv(newShader, GL_COMPILE_STATUS, &result);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
     if (!result)
     {
-        glGetShaderInfoLog(newShader, sizeof(errorMessage), nullptr, errorMessage);
+        glGetShaderInfoLog(shader, sizeof(errorMessage), nullptr, errorMessage);
         std::cout << "Error compiling the " << type << " shader: " << errorMessage;
-        return;
+        return false;
     }
-
-    // Attach new shader to the shader program
-    glAttachShader(program, newShader);
+    return true;
 }
 
 std::string Shader::readFile(const char* path)
@@ -111,24 +274,50 @@ std::string Shader::readFile(const char* path)
 
 void Shader::use()
 {
-    glUseProgram(m_ID);
+    GLStateCache::useProgram(m_ID);
+}
+
+void Shader::swap(Shader& other)
+{
+    std::swap(m_ID, other.m_ID);
+    std::swap(m_Uniforms, other.m_Uniforms);
+    std::swap(m_VertexShader, other.m_VertexShader);
+    std::swap(m_FragmentShader, other.m_FragmentShader);
+    std::swap(m_CacheKey, other.m_CacheKey);
+    std::swap(m_Pending, other.m_Pending);
+    std::swap(m_Ready, other.m_Ready);
 }
 
 void Shader::clear()
 {
+    if (m_VertexShader != 0)
+    {
+        glDeleteShader(m_VertexShader);
+        m_VertexShader = 0;
+    }
+
+    if (m_FragmentShader != 0)
+    {
+        glDeleteShader(m_FragmentShader);
+        m_FragmentShader = 0;
+    }
+
     if (m_ID != 0)
     {
+        GLStateCache::forgetProgram(m_ID);
         glDeleteProgram(m_ID);
         m_ID = 0;
     }
 
-    m_UniformModel = 0;
-    m_UniformProjection = 0;
+    m_Uniforms.clear();
+    m_CacheKey = 0;
+    m_Pending = m_Ready = false;
 }
 
 void Shader::createFromStrings(const char* vertexSource, const char* fragmentSource)
 {
-    compile(vertexSource, fragmentSource);
+    beginCreateFromStrings(vertexSource, fragmentSource);
+    finishCreate();
 }
 
 void Shader::createFromFiles(const char* vertexSourceFile, const char* fragmentSourceFile)
@@ -136,4 +325,56 @@ void Shader::createFromFiles(const char* vertexSourceFile, const char* fragmentS
     std::string vertexSource = readFile(vertexSourceFile),
                 fragmentSource = readFile(fragmentSourceFile);
     createFromStrings(vertexSource.c_str(), fragmentSource.c_str());
-}
\ No newline at end of file
+}
+
+void Shader::beginCreateFromStrings(const char* vertexSource, const char* fragmentSource)
+{
+    clear();
+
+    if (ShaderCache::isEnabled())
+    {
+        // Warm start: restore the linked program without touching the GLSL compiler
+        uint64_t key = ShaderCache::makeKey(vertexSource, fragmentSource);
+        m_ID = glCreateProgram();
+        if (m_ID != 0 && ShaderCache::load(m_ID, key))
+        {
+            queryUniforms();
+            m_Ready = true;
+            return;
+        }
+
+        // Cache miss or stale binary: compile from source and remember the result in finishCreate()
+        clear();
+        m_CacheKey = key;
+    }
+
+    beginCompile(vertexSource, fragmentSource);
+}
+
+void Shader::beginCreateFromFiles(const char* vertexSourceFile, const char* fragmentSourceFile)
+{
+    std::string vertexSource = readFile(vertexSourceFile),
+                fragmentSource = readFile(fragmentSourceFile);
+    beginCreateFromStrings(vertexSource.c_str(), fragmentSource.c_str());
+}
+
+bool Shader::isCompileComplete() const
+{
+    if (!m_Pending) return true;
+
+    // Without the extension the status query would block, so report completion and let finishCreate() wait
+    if (!supportsParallelCompile()) return true;
+
+    int complete = 0;
+    glGetProgramiv(m_ID, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete != 0;
+}
+
+bool Shader::finishCreate()
+{
+    if (!m_Pending) return m_Ready;
+
+    if (!finishCompile()) return false;
+    if (m_CacheKey != 0) ShaderCache::store(m_ID, m_CacheKey);
+    return true;
+}
@@ -3,8 +3,39 @@
 //
 
 #pragma once
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// A uniform name hashed with 32-bit FNV-1a at compile time, so lookups never compare strings
+class UniformName
+{
+public:
+    consteval UniformName(const char* name) : m_Hash(hash(name)) {}
+
+    // For names only known at runtime
+    static UniformName fromString(const char* name) { return UniformName(hash(name), 0); }
+
+    static constexpr uint32_t hash(const char* name)
+    {
+        uint32_t value = 0x811C9DC5u;
+        for (; *name != '\0'; name++)
+        {
+            value ^= (unsigned char) *name;
+            value *= 0x01000193u;
+        }
+
+        // Zero marks empty slots in Shader's uniform table
+        return value != 0 ? value : 1;
+    }
+
+    constexpr uint32_t getHash() const { return m_Hash; }
+private:
+    constexpr UniformName(uint32_t hash, int) : m_Hash(hash) {}
+    uint32_t m_Hash;
+};
 
 class Shader
 {
@@ -12,16 +43,56 @@ public:
     Shader() = default;
     ~Shader() = default;
 private:
-    unsigned int m_ID, m_UniformProjection, m_UniformModel;
+    // Open-addressing table of every active uniform, keyed by name hash
+    struct UniformSlot
+    {
+        uint32_t hash;
+        int location;
+    };
+
+    unsigned int m_ID = 0;
+    std::vector<UniformSlot> m_Uniforms;
+
+    // Compile state between beginCreate*() and finishCreate()
+    unsigned int m_VertexShader = 0, m_FragmentShader = 0;
+    uint64_t m_CacheKey = 0;
+    bool m_Pending = false, m_Ready = false;
 private:
-    void compile(const char* vertexSource, const char* fragmentSource);
-    static void add(unsigned int program, const char* shaderSource, GLenum shaderType);
+    bool beginCompile(const char* vertexSource, const char* fragmentSource);
+    bool finishCompile();
+    void queryUniforms();
+    void insertUniform(const char* name, int location);
+    static unsigned int add(unsigned int program, const char* shaderSource, GLenum shaderType);
+    static bool checkCompile(unsigned int shader, GLenum shaderType);
     static std::string readFile(const char* path);
 public:
     void createFromStrings(const char* vertexSource, const char* fragmentSource);
     void createFromFiles(const char* vertexSourceFile, const char* fragmentSourceFile);
-    constexpr unsigned int getProjectionLocation() const { return m_UniformProjection; }
-    constexpr unsigned int getModelLocation() const { return m_UniformModel; }
+
+    // Non-blocking creation: begin*() submits compile and link, finishCreate() collects the result
+    void beginCreateFromStrings(const char* vertexSource, const char* fragmentSource);
+    void beginCreateFromFiles(const char* vertexSourceFile, const char* fragmentSourceFile);
+    bool isCompileComplete() const;
+    bool finishCreate();
+
+    constexpr bool isReady() const { return m_Ready; }
+    constexpr bool isCompiling() const { return m_Pending; }
+
+    // Exchanges programs with another shader, e.g. to hot-swap a rebuilt program into one already in use
+    void swap(Shader& other);
+
+    constexpr unsigned int getID() const { return m_ID; }
+    int getUniformLocation(UniformName name) const;
+    unsigned int getProjectionLocation() const { return (unsigned int) getUniformLocation("projection"); }
+    unsigned int getModelLocation() const { return (unsigned int) getUniformLocation("model"); }
+
+    // Binds the program (through the state cache) and sets the uniform; unknown names are ignored
+    void setUniform(UniformName name, int value);
+    void setUniform(UniformName name, float value);
+    void setUniform(UniformName name, const glm::vec2& value);
+    void setUniform(UniformName name, const glm::vec3& value);
+    void setUniform(UniformName name, const glm::vec4& value);
+    void setUniform(UniformName name, const glm::mat4& value);
     void use();
     void clear();
 };
\ No newline at end of file
@@ -0,0 +1,134 @@
+//
+// On-disk cache of linked shader program binaries
+//
+
+#include "shadercache.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cstdio>
+#include <vector>
+#include <GL/glew.h>
+
+#ifdef SHADER_CACHE_DIR
+std::string ShaderCache::s_Directory = SHADER_CACHE_DIR;
+#else
+std::string ShaderCache::s_Directory;
+#endif
+
+namespace
+{
+    constexpr uint32_t cacheMagic = 0x42504C47; // "GLPB"
+    constexpr uint32_t cacheVersion = 1;
+
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t format;
+        uint32_t length;
+    };
+
+    // 64-bit FNV-1a, including the terminator so "ab"+"c" and "a"+"bc" hash differently
+    uint64_t hash(uint64_t value, const char* text)
+    {
+        if (text == nullptr) text = "";
+        do
+        {
+            value ^= (unsigned char) *text;
+            value *= 0x100000001B3ull;
+        }
+        while (*text++);
+        return value;
+    }
+}
+
+bool ShaderCache::isEnabled()
+{
+    if (s_Directory.empty()) return false;
+
+    // Binaries are only retrievable with GL 4.1 / ARB_get_program_binary, and some drivers expose no formats
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) return false;
+
+    int formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    return formatCount > 0;
+}
+
+uint64_t ShaderCache::makeKey(const char* vertexSource, const char* fragmentSource)
+{
+    uint64_t key = 0xCBF29CE484222325ull;
+    key = hash(key, vertexSource);
+    key = hash(key, fragmentSource);
+    key = hash(key, (const char*) glGetString(GL_VENDOR));
+    key = hash(key, (const char*) glGetString(GL_RENDERER));
+    key = hash(key, (const char*) glGetString(GL_VERSION));
+    return key;
+}
+
+std::string ShaderCache::getPath(uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+    return (std::filesystem::path(s_Directory) / name).string();
+}
+
+bool ShaderCache::load(unsigned int program, uint64_t key)
+{
+    std::ifstream infile(getPath(key), std::ios::in | std::ios::binary);
+    if (!infile.is_open()) return false;
+
+    CacheHeader header {};
+    infile.read((char*) &header, sizeof(header));
+    if (!infile || header.magic != cacheMagic || header.version != cacheVersion || header.key != key)
+        return false;
+
+    std::vector<char> binary(header.length);
+    infile.read(binary.data(), header.length);
+    if (!infile) return false;
+
+    glProgramBinary(program, header.format, binary.data(), (int) header.length);
+
+    // Drivers may reject a binary from another build even when the version string matches
+    int result = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &result);
+    return result != 0;
+}
+
+void ShaderCache::store(unsigned int program, uint64_t key)
+{
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    CacheHeader header {};
+    header.magic = cacheMagic;
+    header.version = cacheVersion;
+    header.key = key;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+    header.format = format;
+    header.length = (uint32_t) length;
+
+    std::error_code error;
+    std::filesystem::create_directories(s_Directory, error);
+
+    // Write to a temporary file first so a concurrent reader never sees a half-written entry
+    std::string path = getPath(key), temporaryPath = path + ".tmp";
+    {
+        std::ofstream outfile(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!outfile.is_open())
+        {
+            std::cout << "Failed to write shader cache file \"" << temporaryPath << "\"\n";
+            return;
+        }
+
+        outfile.write((const char*) &header, sizeof(header));
+        outfile.write(binary.data(), length);
+    }
+    std::filesystem::rename(temporaryPath, path, error);
+}
@@ -0,0 +1,31 @@
+//
+// On-disk cache of linked shader program binaries
+//
+
+#pragma once
+#include <cstdint>
+#include <string>
+
+/* Stores linked programs with glGetProgramBinary and restores them with glProgramBinary, so warm
+ * starts skip GLSL compilation. Entries are keyed by a hash of the shader sources together with
+ * the driver vendor, renderer and version strings; a driver update simply misses the cache.
+ */
+class ShaderCache
+{
+public:
+    ShaderCache() = delete;
+private:
+    static std::string s_Directory;
+private:
+    static std::string getPath(uint64_t key);
+public:
+    // An empty directory disables the cache; defaults to SHADER_CACHE_DIR when CMake sets it
+    static void setDirectory(const std::string& directory) { s_Directory = directory; }
+    static bool isEnabled();
+
+    static uint64_t makeKey(const char* vertexSource, const char* fragmentSource);
+
+    // Loads a cached binary into an existing program object; false on miss or driver rejection
+    static bool load(unsigned int program, uint64_t key);
+    static void store(unsigned int program, uint64_t key);
+};
@@ -0,0 +1,68 @@
+//
+// Asynchronous shader program compilation
+//
+
+#include "shadercompiler.h"
+
+ShaderCompiler::ShaderCompiler()
+{
+    // Let the driver pick how many compiler threads to use
+    if (GLEW_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    else if (GLEW_ARB_parallel_shader_compile) glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+}
+
+bool ShaderCompiler::isParallel()
+{
+    return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+}
+
+std::shared_ptr<Shader> ShaderCompiler::submitStrings(const char* vertexSource, const char* fragmentSource)
+{
+    auto shader = std::make_shared<Shader>();
+    shader->beginCreateFromStrings(vertexSource, fragmentSource);
+
+    // Cache hits are ready straight away
+    if (!shader->isReady()) m_Pending.push_back(shader);
+    return shader;
+}
+
+std::shared_ptr<Shader> ShaderCompiler::submitFiles(const char* vertexSourceFile, const char* fragmentSourceFile)
+{
+    auto shader = std::make_shared<Shader>();
+    shader->beginCreateFromFiles(vertexSourceFile, fragmentSourceFile);
+
+    if (!shader->isReady()) m_Pending.push_back(shader);
+    return shader;
+}
+
+void ShaderCompiler::poll()
+{
+    // Without parallel compile every finish stalls, so take only the oldest program per call
+    if (!isParallel())
+    {
+        if (m_Pending.empty()) return;
+
+        // Failed programs are dropped too; they stay not ready and keep using the fallback
+        m_Pending.front()->finishCreate();
+        m_Pending.erase(m_Pending.begin());
+        return;
+    }
+
+    for (auto shader = m_Pending.begin(); shader != m_Pending.end(); )
+    {
+        if (!(*shader)->isCompileComplete())
+        {
+            shader++;
+            continue;
+        }
+
+        (*shader)->finishCreate();
+        shader = m_Pending.erase(shader);
+    }
+}
+
+void ShaderCompiler::finishAll()
+{
+    for (const auto& shader : m_Pending) shader->finishCreate();
+    m_Pending.clear();
+}
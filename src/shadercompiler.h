@@ -0,0 +1,35 @@
+//
+// Asynchronous shader program compilation
+//
+
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "shader.h"
+
+/* Starts every compile and link up front and collects the results later, so loading many programs
+ * doesn't serialize on status queries. With KHR_parallel_shader_compile the driver compiles on its
+ * own threads and poll() only finishes programs that report GL_COMPLETION_STATUS_KHR; without it,
+ * poll() finishes one program per call to spread the stalls over several frames.
+ *
+ * Submitted shaders report isReady() once finished; render with a fallback program until then.
+ */
+class ShaderCompiler
+{
+public:
+    ShaderCompiler();
+    ~ShaderCompiler() = default;
+private:
+    std::vector<std::shared_ptr<Shader>> m_Pending;
+public:
+    static bool isParallel();
+
+    std::shared_ptr<Shader> submitStrings(const char* vertexSource, const char* fragmentSource);
+    std::shared_ptr<Shader> submitFiles(const char* vertexSourceFile, const char* fragmentSourceFile);
+
+    void poll();
+    void finishAll();
+
+    size_t getPendingCount() const { return m_Pending.size(); }
+};
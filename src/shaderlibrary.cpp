@@ -0,0 +1,161 @@
+//
+// Named shader programs with hot reload
+//
+
+#include "shaderlibrary.h"
+
+#include <iostream>
+#include <filesystem>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+namespace
+{
+    // Paths are compared in canonical form so events match however the file was named in load()
+    std::string canonical(const std::string& path)
+    {
+        std::error_code error;
+        std::filesystem::path result = std::filesystem::weakly_canonical(path, error);
+        return error ? path : result.string();
+    }
+}
+
+ShaderLibrary::ShaderLibrary(ShaderCompiler& compiler) : m_Compiler(compiler)
+{
+    m_Inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    m_StopEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_Inotify < 0 || m_StopEvent < 0)
+    {
+        std::cout << "Failed to set up shader file watching; hot reload is disabled\n";
+        return;
+    }
+
+    m_Watcher = std::thread(&ShaderLibrary::watchLoop, this);
+}
+
+ShaderLibrary::~ShaderLibrary()
+{
+    if (m_Watcher.joinable())
+    {
+        uint64_t stop = 1;
+        if (write(m_StopEvent, &stop, sizeof(stop)) < 0) {}
+        m_Watcher.join();
+    }
+
+    if (m_Inotify >= 0) close(m_Inotify);
+    if (m_StopEvent >= 0) close(m_StopEvent);
+
+    for (auto& [name, entry] : m_Entries)
+        if (entry.rebuild) entry.rebuild->clear();
+}
+
+void ShaderLibrary::watch(const std::string& file)
+{
+    if (m_Inotify < 0) return;
+
+    // Watch the directory rather than the file: editors often save by writing a new file and renaming it
+    std::string directory = std::filesystem::path(file).parent_path().string();
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (const auto& [descriptor, watched] : m_WatchedDirectories)
+        if (watched == directory) return;
+
+    int descriptor = inotify_add_watch(m_Inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (descriptor < 0)
+    {
+        std::cout << "Failed to watch shader directory \"" << directory << "\"\n";
+        return;
+    }
+    m_WatchedDirectories[descriptor] = directory;
+}
+
+void ShaderLibrary::watchLoop()
+{
+    alignas(inotify_event) char buffer[4096];
+    pollfd descriptors[2] = {
+            { m_Inotify, POLLIN, 0 },
+            { m_StopEvent, POLLIN, 0 }
+    };
+
+    while (true)
+    {
+        if (poll(descriptors, 2, -1) < 0) continue;
+        if (descriptors[1].revents & POLLIN) return;
+        if (!(descriptors[0].revents & POLLIN)) continue;
+
+        ssize_t length;
+        while ((length = read(m_Inotify, buffer, sizeof(buffer))) > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            for (char* cursor = buffer; cursor < buffer + length;)
+            {
+                auto* event = (inotify_event*) cursor;
+                cursor += sizeof(inotify_event) + event->len;
+
+                auto directory = m_WatchedDirectories.find(event->wd);
+                if (event->len == 0 || directory == m_WatchedDirectories.end()) continue;
+
+                m_ChangedFiles.insert(directory->second + '/' + event->name);
+            }
+        }
+    }
+}
+
+std::shared_ptr<Shader> ShaderLibrary::load(const std::string& name, const char* vertexSourceFile, const char* fragmentSourceFile)
+{
+    Entry entry;
+    entry.vertexFile = canonical(vertexSourceFile);
+    entry.fragmentFile = canonical(fragmentSourceFile);
+    entry.shader = m_Compiler.submitFiles(entry.vertexFile.c_str(), entry.fragmentFile.c_str());
+
+    watch(entry.vertexFile);
+    watch(entry.fragmentFile);
+
+    std::shared_ptr<Shader> shader = entry.shader;
+    m_Entries[name] = std::move(entry);
+    return shader;
+}
+
+std::shared_ptr<Shader> ShaderLibrary::get(const std::string& name) const
+{
+    auto entry = m_Entries.find(name);
+    return entry != m_Entries.end() ? entry->second.shader : nullptr;
+}
+
+void ShaderLibrary::update()
+{
+    std::unordered_set<std::string> changedFiles;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        changedFiles.swap(m_ChangedFiles);
+    }
+
+    for (auto& [name, entry] : m_Entries)
+    {
+        // Start (or restart) a rebuild when either source changed
+        if (changedFiles.contains(entry.vertexFile) || changedFiles.contains(entry.fragmentFile))
+        {
+            if (entry.rebuild) entry.rebuild->clear();
+            entry.rebuild = m_Compiler.submitFiles(entry.vertexFile.c_str(), entry.fragmentFile.c_str());
+        }
+
+        if (!entry.rebuild || entry.rebuild->isCompiling()) continue;
+
+        // Swap at the frame boundary; the old program is released with the rebuild object
+        if (entry.rebuild->isReady())
+        {
+            entry.shader->swap(*entry.rebuild);
+            std::cout << "Reloaded shader \"" << name << "\"\n";
+        }
+        else
+        {
+            std::cout << "Shader \"" << name << "\" failed to rebuild; keeping the previous program\n";
+        }
+
+        entry.rebuild->clear();
+        entry.rebuild.reset();
+    }
+}
@@ -0,0 +1,54 @@
+//
+// Named shader programs with hot reload
+//
+
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "shader.h"
+#include "shadercompiler.h"
+
+/* Owns named programs and watches their source files with inotify on a background thread. When a
+ * file changes, update() rebuilds the affected programs through the ShaderCompiler and, once a
+ * rebuild has linked, swaps the new program into the Shader object callers already hold. A rebuild
+ * that fails to compile keeps the previous program.
+ *
+ * update() must be called on the GL thread at a frame boundary, after ShaderCompiler::poll().
+ */
+class ShaderLibrary
+{
+public:
+    explicit ShaderLibrary(ShaderCompiler& compiler);
+    ~ShaderLibrary();
+private:
+    struct Entry
+    {
+        std::string vertexFile, fragmentFile;
+        std::shared_ptr<Shader> shader;     // Handed out to callers; its program is swapped in place
+        std::shared_ptr<Shader> rebuild;    // Replacement program still compiling
+    };
+
+    ShaderCompiler& m_Compiler;
+    std::unordered_map<std::string, Entry> m_Entries;
+
+    // Watcher thread state; everything below the mutex is shared with it
+    int m_Inotify = -1, m_StopEvent = -1;
+    std::thread m_Watcher;
+    std::mutex m_Mutex;
+    std::unordered_map<int, std::string> m_WatchedDirectories;
+    std::unordered_set<std::string> m_ChangedFiles;
+private:
+    void watch(const std::string& file);
+    void watchLoop();
+public:
+    // Starts compiling the program (see ShaderCompiler) and returns it; paths are watched for changes
+    std::shared_ptr<Shader> load(const std::string& name, const char* vertexSourceFile, const char* fragmentSourceFile);
+    std::shared_ptr<Shader> get(const std::string& name) const;
+
+    void update();
+};
@@ -0,0 +1,234 @@
+//
+// Shadow copy of GL binding and pipeline state
+//
+
+#include "statecache.h"
+
+#include <array>
+
+namespace
+{
+    // Never a valid GL name or enum, so the first request after invalidate() always goes through
+    constexpr unsigned int unknown = ~0u;
+
+    constexpr GLenum bufferTargets[] = {
+            GL_ARRAY_BUFFER,
+            GL_ELEMENT_ARRAY_BUFFER,
+            GL_COPY_READ_BUFFER,
+            GL_COPY_WRITE_BUFFER,
+            GL_DRAW_INDIRECT_BUFFER,
+            GL_UNIFORM_BUFFER,
+            GL_PIXEL_PACK_BUFFER,
+            GL_PIXEL_UNPACK_BUFFER
+    };
+    constexpr int bufferTargetCount = sizeof(bufferTargets) / sizeof(bufferTargets[0]);
+
+    constexpr GLenum capabilities[] = {
+            GL_DEPTH_TEST,
+            GL_BLEND,
+            GL_CULL_FACE,
+            GL_SCISSOR_TEST
+    };
+    constexpr int capabilityCount = sizeof(capabilities) / sizeof(capabilities[0]);
+
+    template<int N>
+    std::array<unsigned int, N> unknownArray()
+    {
+        std::array<unsigned int, N> values {};
+        values.fill(unknown);
+        return values;
+    }
+
+    unsigned int program = unknown, vertexArray = unknown;
+    unsigned int drawFramebuffer = unknown, readFramebuffer = unknown;
+    std::array<unsigned int, bufferTargetCount> buffers = unknownArray<bufferTargetCount>();
+    std::array<unsigned int, capabilityCount> capabilityStates = unknownArray<capabilityCount>();
+    unsigned int depthFunction = unknown, depthWrites = unknown;
+    unsigned int blendSource = unknown, blendDestination = unknown;
+
+    unsigned long long issued = 0, elided = 0;
+
+    int bufferSlot(GLenum target)
+    {
+        for (int slot = 0; slot < bufferTargetCount; slot++)
+            if (bufferTargets[slot] == target) return slot;
+        return -1;
+    }
+
+    int capabilitySlot(GLenum capability)
+    {
+        for (int slot = 0; slot < capabilityCount; slot++)
+            if (capabilities[slot] == capability) return slot;
+        return -1;
+    }
+
+    // Returns true (and records the new value) if the driver call is needed
+    bool change(unsigned int& cached, unsigned int value)
+    {
+        if (cached == value)
+        {
+            elided++;
+            return false;
+        }
+
+        cached = value;
+        issued++;
+        return true;
+    }
+}
+
+void GLStateCache::useProgram(unsigned int id)
+{
+    if (change(program, id)) glUseProgram(id);
+}
+
+void GLStateCache::bindVertexArray(unsigned int id)
+{
+    if (!change(vertexArray, id)) return;
+
+    glBindVertexArray(id);
+    buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = unknown;
+}
+
+void GLStateCache::bindBuffer(GLenum target, unsigned int id)
+{
+    int slot = bufferSlot(target);
+    if (slot < 0)
+    {
+        issued++;
+        glBindBuffer(target, id);
+        return;
+    }
+
+    if (change(buffers[slot], id)) glBindBuffer(target, id);
+}
+
+void GLStateCache::bindBufferBase(GLenum target, unsigned int index, unsigned int id)
+{
+    int slot = bufferSlot(target);
+    if (slot >= 0) buffers[slot] = id;
+
+    issued++;
+    glBindBufferBase(target, index, id);
+}
+
+void GLStateCache::bindBufferRange(GLenum target, unsigned int index, unsigned int id, GLintptr offset, GLsizeiptr size)
+{
+    int slot = bufferSlot(target);
+    if (slot >= 0) buffers[slot] = id;
+
+    issued++;
+    glBindBufferRange(target, index, id, offset, size);
+}
+
+void GLStateCache::bindFramebuffer(GLenum target, unsigned int id)
+{
+    if (target == GL_FRAMEBUFFER)
+    {
+        if (drawFramebuffer == id && readFramebuffer == id)
+        {
+            elided++;
+            return;
+        }
+
+        drawFramebuffer = readFramebuffer = id;
+        issued++;
+        glBindFramebuffer(target, id);
+        return;
+    }
+
+    unsigned int& cached = target == GL_READ_FRAMEBUFFER ? readFramebuffer : drawFramebuffer;
+    if (change(cached, id)) glBindFramebuffer(target, id);
+}
+
+void GLStateCache::enable(GLenum capability)
+{
+    int slot = capabilitySlot(capability);
+    if (slot < 0 || change(capabilityStates[slot], 1))
+    {
+        if (slot < 0) issued++;
+        glEnable(capability);
+    }
+}
+
+void GLStateCache::disable(GLenum capability)
+{
+    int slot = capabilitySlot(capability);
+    if (slot < 0 || change(capabilityStates[slot], 0))
+    {
+        if (slot < 0) issued++;
+        glDisable(capability);
+    }
+}
+
+void GLStateCache::depthFunc(GLenum function)
+{
+    if (change(depthFunction, function)) glDepthFunc(function);
+}
+
+void GLStateCache::depthMask(bool enabled)
+{
+    if (change(depthWrites, enabled ? 1 : 0)) glDepthMask(enabled);
+}
+
+void GLStateCache::blendFunc(GLenum source, GLenum destination)
+{
+    if (blendSource == source && blendDestination == destination)
+    {
+        elided++;
+        return;
+    }
+
+    blendSource = source;
+    blendDestination = destination;
+    issued++;
+    glBlendFunc(source, destination);
+}
+
+void GLStateCache::forgetProgram(unsigned int id)
+{
+    // A deleted program stays in use until another one is bound, but its name may be reused later
+    if (program == id) program = unknown;
+}
+
+void GLStateCache::forgetVertexArray(unsigned int id)
+{
+    if (vertexArray == id) vertexArray = 0;
+}
+
+void GLStateCache::forgetBuffer(unsigned int id)
+{
+    for (unsigned int& buffer : buffers)
+        if (buffer == id) buffer = 0;
+}
+
+void GLStateCache::forgetFramebuffer(unsigned int id)
+{
+    if (drawFramebuffer == id) drawFramebuffer = 0;
+    if (readFramebuffer == id) readFramebuffer = 0;
+}
+
+void GLStateCache::invalidate()
+{
+    program = vertexArray = unknown;
+    drawFramebuffer = readFramebuffer = unknown;
+    buffers.fill(unknown);
+    capabilityStates.fill(unknown);
+    depthFunction = depthWrites = unknown;
+    blendSource = blendDestination = unknown;
+}
+
+unsigned long long GLStateCache::getIssuedCount()
+{
+    return issued;
+}
+
+unsigned long long GLStateCache::getElidedCount()
+{
+    return elided;
+}
+
+void GLStateCache::resetCounters()
+{
+    issued = elided = 0;
+}
@@ -0,0 +1,46 @@
+//
+// Shadow copy of GL binding and pipeline state
+//
+
+#pragma once
+#include <GL/glew.h>
+
+/* Tracks the currently bound program, VAO, framebuffer and buffers plus depth/blend state, and
+ * skips the driver call when a request would not change anything. All GL binds in the renderer
+ * go through here; code that touches GL directly must call invalidate() afterwards.
+ *
+ * The GL_ELEMENT_ARRAY_BUFFER binding belongs to the bound VAO, so binding a VAO forgets it.
+ */
+class GLStateCache
+{
+public:
+    GLStateCache() = delete;
+public:
+    static void useProgram(unsigned int program);
+    static void bindVertexArray(unsigned int vertexArray);
+    static void bindBuffer(GLenum target, unsigned int buffer);
+
+    // Indexed binds are always issued, but also move the generic binding of the target
+    static void bindBufferBase(GLenum target, unsigned int index, unsigned int buffer);
+    static void bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size);
+    static void bindFramebuffer(GLenum target, unsigned int framebuffer);
+
+    static void enable(GLenum capability);
+    static void disable(GLenum capability);
+    static void depthFunc(GLenum function);
+    static void depthMask(bool enabled);
+    static void blendFunc(GLenum source, GLenum destination);
+
+    // Must be called when deleting GL objects, since GL silently unbinds them
+    static void forgetProgram(unsigned int program);
+    static void forgetVertexArray(unsigned int vertexArray);
+    static void forgetBuffer(unsigned int buffer);
+    static void forgetFramebuffer(unsigned int framebuffer);
+
+    // Marks everything unknown so the next request of each kind reaches the driver
+    static void invalidate();
+
+    static unsigned long long getIssuedCount();
+    static unsigned long long getElidedCount();
+    static void resetCounters();
+};
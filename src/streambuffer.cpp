@@ -0,0 +1,172 @@
+//
+// Per-frame streaming through a fenced ring buffer
+//
+
+#include "streambuffer.h"
+#include "statecache.h"
+#include "renderstats.h"
+
+#include <algorithm>
+
+StreamBuffer::StreamBuffer() : m_Buffer(0), m_SegmentSize(0), m_Head(0), m_Segment(0), m_Fences {}, m_SegmentReady(false),
+                               m_Persistent(false), m_PersistentData(nullptr), m_Mapped(false)
+{}
+
+StreamBuffer::~StreamBuffer()
+{
+    clear();
+}
+
+void StreamBuffer::create(size_t bytesPerFrame)
+{
+    m_Persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+    allocateStorage(std::max<size_t>(bytesPerFrame, 1));
+}
+
+void StreamBuffer::allocateStorage(size_t segmentSize)
+{
+    // Fresh storage isn't used by any draw, so the old fences no longer matter
+    for (GLsync& fence : m_Fences)
+    {
+        if (fence != nullptr) glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    m_SegmentSize = segmentSize;
+    m_Head = 0;
+    m_Segment = 0;
+    m_SegmentReady = true;
+
+    // Everything goes through the copy target so the bound VAO's element buffer is left alone
+    if (m_Persistent)
+    {
+        // Immutable storage can't be orphaned; replace the buffer (draws already issued keep the old one alive)
+        if (m_Buffer != 0)
+        {
+            GLStateCache::bindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            GLStateCache::forgetBuffer(m_Buffer);
+            glDeleteBuffers(1, &m_Buffer);
+        }
+
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &m_Buffer);
+        GLStateCache::bindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+        glBufferStorage(GL_COPY_WRITE_BUFFER, (GLsizeiptr) (m_SegmentSize * segmentCount), nullptr, flags);
+        m_PersistentData = (unsigned char*) glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr) (m_SegmentSize * segmentCount), flags);
+        return;
+    }
+
+    if (m_Buffer == 0) glGenBuffers(1, &m_Buffer);
+    GLStateCache::bindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr) (m_SegmentSize * segmentCount), nullptr, GL_STREAM_DRAW);
+}
+
+void StreamBuffer::waitForSegment()
+{
+    m_SegmentReady = true;
+
+    GLsync& fence = m_Fences[m_Segment];
+    if (fence == nullptr) return;
+
+    if (m_Persistent)
+    {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fence);
+        fence = nullptr;
+        return;
+    }
+
+    // Without persistent mapping, orphan the ring instead of stalling on a segment the GPU still reads
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+    {
+        glDeleteSync(fence);
+        fence = nullptr;
+        return;
+    }
+
+    int segment = m_Segment;
+    allocateStorage(m_SegmentSize);
+    m_Segment = segment;
+}
+
+void* StreamBuffer::allocate(size_t bytes, size_t alignment, size_t& offset)
+{
+    flush();
+
+    // Align the offset within the whole buffer: segments start at multiples of the segment size,
+    // which needn't be a multiple of alignment
+    size_t segmentOffset = getSegmentOffset();
+    size_t start = (segmentOffset + m_Head + alignment - 1) / alignment * alignment - segmentOffset;
+    if (start + bytes > m_SegmentSize)
+    {
+        // Out of room this frame: reallocate with room to spare
+        allocateStorage(std::max(m_SegmentSize * 2, bytes * 2));
+        start = 0;      // Segment 0 starts the buffer, so any alignment holds
+    }
+
+    if (!m_SegmentReady) waitForSegment();
+
+    offset = getSegmentOffset() + start;
+    m_Head = start + bytes;
+    RenderStats::countUpload(bytes);
+
+    if (m_Persistent) return m_PersistentData + offset;
+
+    GLStateCache::bindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+    void* data = glMapBufferRange(GL_COPY_WRITE_BUFFER, (GLintptr) offset, (GLsizeiptr) bytes,
+                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    m_Mapped = data != nullptr;
+    return data;
+}
+
+void StreamBuffer::flush()
+{
+    // Coherent persistent mappings need nothing; writes are visible to later commands
+    if (!m_Mapped) return;
+
+    GLStateCache::bindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    m_Mapped = false;
+}
+
+void StreamBuffer::endFrame()
+{
+    flush();
+    if (m_Head == 0) return;
+
+    // Fence the segment this frame wrote and move on to the next one
+    m_Fences[m_Segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_Segment = (m_Segment + 1) % segmentCount;
+    m_Head = 0;
+    m_SegmentReady = false;
+}
+
+void StreamBuffer::clear()
+{
+    flush();
+
+    for (GLsync& fence : m_Fences)
+    {
+        if (fence != nullptr) glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    if (m_Buffer != 0)
+    {
+        if (m_PersistentData != nullptr)
+        {
+            GLStateCache::bindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            m_PersistentData = nullptr;
+        }
+
+        GLStateCache::forgetBuffer(m_Buffer);
+        glDeleteBuffers(1, &m_Buffer);
+        m_Buffer = 0;
+    }
+
+    m_SegmentSize = m_Head = 0;
+    m_Segment = 0;
+}
@@ -0,0 +1,62 @@
+//
+// Per-frame streaming through a fenced ring buffer
+//
+
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+
+/* A buffer split into three per-frame segments for data rewritten every frame. allocate() hands out
+ * write pointers from the current segment; endFrame() fences it and moves on, and the first
+ * allocation in a segment makes sure the GPU is done with what was written there three frames ago.
+ *
+ * With GL 4.4 / ARB_buffer_storage the whole ring is mapped once, persistently and coherently, so
+ * allocating is pointer arithmetic. Otherwise each allocation is an unsynchronized glMapBufferRange
+ * (unmapped by flush()), and a segment still in use is orphaned rather than waited for.
+ *
+ *     size_t offset;
+ *     auto* data = (float*) stream.allocate(bytes, sizeof(float), offset);
+ *     ... write data ...
+ *     stream.flush();
+ *     ... draw from stream.getBuffer() at offset ...
+ *     stream.endFrame();
+ */
+class StreamBuffer
+{
+public:
+    StreamBuffer();
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+private:
+    static constexpr int segmentCount = 3;
+
+    unsigned int m_Buffer;
+    size_t m_SegmentSize, m_Head;
+    int m_Segment;
+    GLsync m_Fences[segmentCount];
+    bool m_SegmentReady;
+
+    bool m_Persistent;
+    unsigned char* m_PersistentData;    // The whole ring, mapped for the buffer's lifetime
+    bool m_Mapped;                      // Fallback path: an allocation is mapped until flush()
+private:
+    size_t getSegmentOffset() const { return m_SegmentSize * m_Segment; }
+    void allocateStorage(size_t segmentSize);
+    void waitForSegment();
+public:
+    // bytesPerFrame is the expected total of one frame's allocations; the ring grows past it if needed
+    void create(size_t bytesPerFrame);
+
+    // Returns a write pointer valid until flush(); offset receives its position in getBuffer().
+    // Offsets are multiples of alignment, which need not be a power of two (e.g. a vertex stride)
+    void* allocate(size_t bytes, size_t alignment, size_t& offset);
+    void flush();
+    void endFrame();
+    void clear();
+
+    // The buffer name changes when the ring grows, so look it up after allocating
+    constexpr unsigned int getBuffer() const { return m_Buffer; }
+    constexpr bool isPersistent() const { return m_Persistent; }
+};
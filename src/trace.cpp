@@ -0,0 +1,124 @@
+//
+// Scoped CPU timers exported as Chrome trace events
+//
+
+#include "trace.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+
+std::atomic<bool> CpuTrace::s_Enabled = false;
+
+namespace
+{
+    // Events per thread; once full, further events are counted and dropped
+    constexpr size_t bufferCapacity = 1 << 16;
+
+    struct TraceEvent
+    {
+        const char* name;
+        uint64_t start, end;
+    };
+
+    struct ThreadBuffer
+    {
+        std::unique_ptr<TraceEvent[]> events { new TraceEvent[bufferCapacity] };
+        std::atomic<size_t> count = 0;          // Published with release so write() sees whole events
+        std::atomic<unsigned long long> dropped = 0;
+        unsigned int threadID = 0;
+    };
+
+    // Buffers are shared with the registry so they outlive the threads that filled them
+    std::mutex registryMutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> registry;
+
+    ThreadBuffer& threadBuffer()
+    {
+        thread_local std::shared_ptr<ThreadBuffer> buffer = []
+        {
+            auto created = std::make_shared<ThreadBuffer>();
+
+            std::lock_guard<std::mutex> lock(registryMutex);
+            created->threadID = (unsigned int) registry.size() + 1;
+            registry.push_back(created);
+            return created;
+        }();
+        return *buffer;
+    }
+
+    void writeEscaped(std::ostream& out, const char* text)
+    {
+        for (; *text != '\0'; text++)
+        {
+            if (*text == '"' || *text == '\\') out << '\\';
+            out << *text;
+        }
+    }
+}
+
+void CpuTrace::record(const char* name, uint64_t start, uint64_t end)
+{
+    ThreadBuffer& buffer = threadBuffer();
+
+    size_t index = buffer.count.load(std::memory_order_relaxed);
+    if (index == bufferCapacity)
+    {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    buffer.events[index] = { name, start, end };
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+bool CpuTrace::write(const char* path)
+{
+    std::ofstream outfile(path, std::ios::out | std::ios::trunc);
+    if (!outfile.is_open())
+    {
+        std::cout << "Failed to write trace file \"" << path << "\"\n";
+        return false;
+    }
+
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers = registry;
+    }
+
+    // Chrome trace timestamps are in microseconds
+    outfile << std::fixed << std::setprecision(3);
+    outfile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    int processID = (int) getpid();
+    for (const auto& buffer : buffers)
+    {
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; i++)
+        {
+            const TraceEvent& event = buffer->events[i];
+            outfile << (first ? "\n" : ",\n") << "{\"name\":\"";
+            writeEscaped(outfile, event.name);
+            outfile << "\",\"ph\":\"X\",\"pid\":" << processID << ",\"tid\":" << buffer->threadID
+                    << ",\"ts\":" << (double) event.start / 1000.0
+                    << ",\"dur\":" << (double) (event.end - event.start) / 1000.0 << '}';
+            first = false;
+        }
+    }
+    outfile << "\n]}\n";
+    return true;
+}
+
+unsigned long long CpuTrace::getDroppedCount()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    unsigned long long dropped = 0;
+    for (const auto& buffer : registry) dropped += buffer->dropped.load(std::memory_order_relaxed);
+    return dropped;
+}
@@ -0,0 +1,54 @@
+//
+// Scoped CPU timers exported as Chrome trace events
+//
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Times the rest of the enclosing block; the name must be a string literal (only the pointer is stored)
+#define TRACE_SCOPE(name) CpuTrace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+/* Records complete ("X") events into per-thread buffers that only their own thread writes, so
+ * recording never locks; a thread takes a mutex once, to register its buffer. write() exports
+ * everything recorded so far as a Chrome/Perfetto trace JSON file and may be called at any time.
+ * While disabled a scope costs one relaxed atomic load.
+ */
+class CpuTrace
+{
+public:
+    CpuTrace() = delete;
+
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name) : m_Name(name), m_Start(isEnabled() ? now() : 0) {}
+        ~Scope() { if (m_Start != 0) record(m_Name, m_Start, now()); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        const char* m_Name;
+        uint64_t m_Start;
+    };
+private:
+    static std::atomic<bool> s_Enabled;
+private:
+    static void record(const char* name, uint64_t start, uint64_t end);
+public:
+    static void setEnabled(bool enabled) { s_Enabled.store(enabled, std::memory_order_relaxed); }
+    static bool isEnabled() { return s_Enabled.load(std::memory_order_relaxed); }
+
+    static uint64_t now()
+    {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static bool write(const char* path);
+    static unsigned long long getDroppedCount();
+};
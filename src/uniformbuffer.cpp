@@ -0,0 +1,151 @@
+//
+// std140 uniform blocks shared by every program
+//
+
+#include "uniformbuffer.h"
+#include "statecache.h"
+#include "renderstats.h"
+
+#include <cstring>
+
+UniformBuffer::UniformBuffer() : m_FrameUBO(0), m_ObjectUBO(0), m_Stride(0), m_Capacity(0), m_Head(0),
+                                 m_Segment(0), m_Fences {}, m_Mapped(nullptr), m_MappedFirst(0)
+{}
+
+UniformBuffer::~UniformBuffer()
+{
+    clear();
+}
+
+void UniformBuffer::create(unsigned int objectsPerFrame)
+{
+    glGenBuffers(1, &m_FrameUBO);
+    GLStateCache::bindBuffer(GL_UNIFORM_BUFFER, m_FrameUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    GLStateCache::bindBufferBase(GL_UNIFORM_BUFFER, FrameBlockBinding, m_FrameUBO);
+
+    // Each block must start on the driver's offset alignment (often 256 bytes)
+    int alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_Stride = (sizeof(ObjectUniforms) + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &m_ObjectUBO);
+    grow(objectsPerFrame);
+}
+
+void UniformBuffer::grow(size_t capacity)
+{
+    m_Capacity = capacity;
+    m_Head = 0;
+    m_Segment = 0;
+
+    // Fresh storage isn't used by any draw, so the old fences no longer matter
+    for (GLsync& fence : m_Fences)
+    {
+        if (fence != nullptr) glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    GLStateCache::bindBuffer(GL_UNIFORM_BUFFER, m_ObjectUBO);
+    glBufferData(GL_UNIFORM_BUFFER, m_Stride * m_Capacity * segmentCount, nullptr, GL_STREAM_DRAW);
+}
+
+void UniformBuffer::setFrame(const FrameUniforms& frame)
+{
+    GLStateCache::bindBuffer(GL_UNIFORM_BUFFER, m_FrameUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+    RenderStats::countUpload(sizeof(FrameUniforms));
+}
+
+unsigned int UniformBuffer::beginObjects(unsigned int count)
+{
+    // Out of room this frame: reallocate (orphaning the old storage) with room to spare
+    if (m_Head + count > m_Capacity) grow((m_Head + count) * 2);
+
+    // Entering this segment for the first time this frame: wait for the GPU to finish reading it
+    GLsync& fence = m_Fences[m_Segment];
+    if (fence != nullptr)
+    {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    m_MappedFirst = (unsigned int) m_Head;
+    m_Head += count;
+
+    GLStateCache::bindBuffer(GL_UNIFORM_BUFFER, m_ObjectUBO);
+    m_Mapped = (unsigned char*) glMapBufferRange(GL_UNIFORM_BUFFER, getSegmentOffset() + m_Stride * m_MappedFirst, m_Stride * count,
+                                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    return m_MappedFirst;
+}
+
+void UniformBuffer::setObject(unsigned int index, const ObjectUniforms& object)
+{
+    if (m_Mapped == nullptr) return;
+
+    std::memcpy(m_Mapped + m_Stride * (index - m_MappedFirst), &object, sizeof(ObjectUniforms));
+    RenderStats::countUpload(sizeof(ObjectUniforms));
+}
+
+void UniformBuffer::endObjects()
+{
+    if (m_Mapped == nullptr) return;
+
+    GLStateCache::bindBuffer(GL_UNIFORM_BUFFER, m_ObjectUBO);
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    m_Mapped = nullptr;
+}
+
+void UniformBuffer::bindObject(unsigned int index)
+{
+    GLStateCache::bindBufferRange(GL_UNIFORM_BUFFER, ObjectBlockBinding, m_ObjectUBO,
+                                  getSegmentOffset() + m_Stride * index, sizeof(ObjectUniforms));
+}
+
+void UniformBuffer::endFrame()
+{
+    if (m_Head == 0) return;
+
+    // Fence the segment this frame wrote and move on to the next one
+    m_Fences[m_Segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_Segment = (m_Segment + 1) % segmentCount;
+    m_Head = 0;
+}
+
+void UniformBuffer::clear()
+{
+    endObjects();
+
+    for (GLsync& fence : m_Fences)
+    {
+        if (fence != nullptr) glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    if (m_ObjectUBO != 0)
+    {
+        GLStateCache::forgetBuffer(m_ObjectUBO);
+        glDeleteBuffers(1, &m_ObjectUBO);
+        m_ObjectUBO = 0;
+    }
+
+    if (m_FrameUBO != 0)
+    {
+        GLStateCache::forgetBuffer(m_FrameUBO);
+        glDeleteBuffers(1, &m_FrameUBO);
+        m_FrameUBO = 0;
+    }
+
+    m_Stride = m_Capacity = m_Head = 0;
+    m_Segment = 0;
+}
+
+void UniformBuffer::bindBlocks(unsigned int program)
+{
+    unsigned int frameBlock = glGetUniformBlockIndex(program, "FrameData");
+    if (frameBlock != GL_INVALID_INDEX) glUniformBlockBinding(program, frameBlock, FrameBlockBinding);
+
+    unsigned int objectBlock = glGetUniformBlockIndex(program, "ObjectData");
+    if (objectBlock != GL_INVALID_INDEX) glUniformBlockBinding(program, objectBlock, ObjectBlockBinding);
+}
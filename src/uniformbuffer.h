@@ -0,0 +1,76 @@
+//
+// std140 uniform blocks shared by every program
+//
+
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Binding points; Shader assigns them to the blocks of the same name after linking
+enum UniformBlockBinding : unsigned int
+{
+    FrameBlockBinding = 0,      // uniform FrameData
+    ObjectBlockBinding = 1      // uniform ObjectData
+};
+
+// Mirrors FrameData in std140 layout
+struct FrameUniforms
+{
+    glm::mat4 view {1.0f};
+    glm::mat4 projection {1.0f};
+    glm::vec4 time {0.0f};      // x = seconds since start, y = frame delta, z = frame number
+};
+
+// Mirrors ObjectData in std140 layout
+struct ObjectUniforms
+{
+    glm::mat4 model {1.0f};
+};
+
+/* Holds the per-frame block, uploaded once per frame, and a ring of per-object blocks. Each frame
+ * writes its objects into its own third of the ring with one unsynchronized map, fenced so the CPU
+ * never overwrites blocks the GPU may still read; draws then select their block with
+ * glBindBufferRange.
+ *
+ *     uniforms.setFrame(frame);
+ *     unsigned int first = uniforms.beginObjects(count);
+ *     for (...) uniforms.setObject(first + i, object);
+ *     uniforms.endObjects();
+ *     for (...) { uniforms.bindObject(first + i); draw(); }
+ *     uniforms.endFrame();
+ */
+class UniformBuffer
+{
+public:
+    UniformBuffer();
+    ~UniformBuffer();
+private:
+    static constexpr int segmentCount = 3;
+
+    unsigned int m_FrameUBO, m_ObjectUBO;
+    size_t m_Stride, m_Capacity, m_Head;
+    int m_Segment;
+    GLsync m_Fences[segmentCount];
+    unsigned char* m_Mapped;
+    unsigned int m_MappedFirst;
+private:
+    size_t getSegmentOffset() const { return m_Stride * m_Capacity * m_Segment; }
+    void grow(size_t capacity);
+public:
+    // Capacity is the number of object blocks a single frame may use; the ring grows past it if needed
+    void create(unsigned int objectsPerFrame);
+
+    void setFrame(const FrameUniforms& frame);
+
+    // Returns the index of the first reserved block
+    unsigned int beginObjects(unsigned int count);
+    void setObject(unsigned int index, const ObjectUniforms& object);
+    void endObjects();
+    void bindObject(unsigned int index);
+
+    void endFrame();
+    void clear();
+
+    // Points a program's FrameData/ObjectData blocks (if it has them) at the shared binding points
+    static void bindBlocks(unsigned int program);
+};
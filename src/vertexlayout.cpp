@@ -0,0 +1,87 @@
+//
+// Interleaved vertex formats
+//
+
+#include "vertexlayout.h"
+
+#include <algorithm>
+
+VertexLayout& VertexLayout::add(VertexSemantic semantic, int components, GLenum type, bool normalized)
+{
+    // Keep attributes 4-byte aligned; some drivers fall back to slow paths otherwise
+    unsigned int offset = 0;
+    for (const VertexAttribute& attribute : m_Attributes)
+        offset = std::max(offset, attribute.offset + getAttributeSize(attribute.components, attribute.type));
+    offset = (offset + 3) & ~3u;
+
+    return add(semantic, components, type, normalized, offset);
+}
+
+VertexLayout& VertexLayout::add(VertexSemantic semantic, int components, GLenum type, bool normalized, unsigned int offset)
+{
+    m_Attributes.push_back({ semantic, components, type, normalized, offset });
+
+    unsigned int end = (offset + getAttributeSize(components, type) + 3) & ~3u;
+    m_Stride = std::max(m_Stride, end);
+    return *this;
+}
+
+VertexLayout& VertexLayout::setStride(unsigned int stride)
+{
+    m_Stride = std::max(m_Stride, stride);
+    return *this;
+}
+
+void VertexLayout::apply() const
+{
+    /* index: Which vertex in buffer
+     * size: Number of elements in buffer
+     * type: Data type
+     * normalized: If 0.0-0.1, then it is already normalized; if 0-255, then it is NOT normalized (I think)
+     * stride: How many bytes from one vertex to the next
+     * pointer: Where to start
+     */
+    for (const VertexAttribute& attribute : m_Attributes)
+    {
+        glVertexAttribPointer(attribute.semantic, attribute.components, attribute.type, attribute.normalized,
+                              (GLsizei) m_Stride, (const void*) (size_t) attribute.offset);
+        glEnableVertexAttribArray(attribute.semantic);
+    }
+}
+
+const VertexAttribute* VertexLayout::find(VertexSemantic semantic) const
+{
+    for (const VertexAttribute& attribute : m_Attributes)
+        if (attribute.semantic == semantic) return &attribute;
+    return nullptr;
+}
+
+VertexLayout VertexLayout::positions()
+{
+    VertexLayout layout;
+    layout.add(PositionAttribute, 3);
+    return layout;
+}
+
+unsigned int VertexLayout::getAttributeSize(int components, GLenum type)
+{
+    switch (type)
+    {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:
+            return components;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT:
+            return 2 * components;
+
+        // Packed formats hold all four components in one 32-bit word
+        case GL_INT_2_10_10_10_REV:
+        case GL_UNSIGNED_INT_2_10_10_10_REV:
+            return 4;
+        case GL_DOUBLE:
+            return 8 * components;
+        default:
+            return 4 * components;
+    }
+}
@@ -0,0 +1,60 @@
+//
+// Interleaved vertex formats
+//
+
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+// Attribute locations per semantic; 1-4 are taken by the per-instance matrix (see Mesh::setInstances)
+enum VertexSemantic : unsigned int
+{
+    PositionAttribute = 0,      // layout (location = 0) in vec3 pos
+    NormalAttribute = 5,
+    TexCoordAttribute = 6,
+    ColorAttribute = 7,
+    TangentAttribute = 8
+};
+
+struct VertexAttribute
+{
+    VertexSemantic semantic;
+    int components;             // 1-4
+    GLenum type;                // GL_FLOAT, GL_HALF_FLOAT, GL_SHORT, GL_UNSIGNED_BYTE, GL_INT_2_10_10_10_REV, ...
+    bool normalized;            // Integer types map to [0, 1] / [-1, 1] instead of their raw value
+    unsigned int offset;        // Bytes from the start of the vertex
+};
+
+/* Describes one interleaved vertex: every attribute lives in the same buffer at a fixed offset
+ * within a stride, so a vertex fetch touches one cache line instead of one per stream.
+ *
+ *     VertexLayout layout;
+ *     layout.add(PositionAttribute, 3).add(NormalAttribute, 3).add(TexCoordAttribute, 2);
+ */
+class VertexLayout
+{
+private:
+    std::vector<VertexAttribute> m_Attributes;
+    unsigned int m_Stride = 0;
+public:
+    // Appends an attribute after the previous one (packed, 4-byte aligned) and grows the stride to fit
+    VertexLayout& add(VertexSemantic semantic, int components, GLenum type = GL_FLOAT, bool normalized = false);
+
+    // Places an attribute at an explicit offset, for matching an existing buffer
+    VertexLayout& add(VertexSemantic semantic, int components, GLenum type, bool normalized, unsigned int offset);
+
+    // Overrides the computed stride (e.g. for padding); must cover every attribute
+    VertexLayout& setStride(unsigned int stride);
+
+    // Points the bound VAO's attributes at the bound GL_ARRAY_BUFFER
+    void apply() const;
+
+    const VertexAttribute* find(VertexSemantic semantic) const;
+    constexpr unsigned int getStride() const { return m_Stride; }
+    const std::vector<VertexAttribute>& getAttributes() const { return m_Attributes; }
+
+    // The format Mesh::create() has always used: three floats of position
+    static VertexLayout positions();
+    static unsigned int getAttributeSize(int components, GLenum type);
+};
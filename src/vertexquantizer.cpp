@@ -0,0 +1,184 @@
+//
+// Compressed vertex formats
+//
+
+#include "vertexquantizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numbers>
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+    float signNotZero(float value)
+    {
+        return value >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    // Octahedral snorm16 pair for a normal, choosing the rounding that decodes closest to it
+    void packNormal(const glm::vec3& normal, uint16_t packed[2])
+    {
+        glm::vec2 encoded = VertexQuantizer::encodeOctahedral(normal);
+
+        // Rounding each component independently can be off by a lot near the octahedron's folds,
+        // so try all four floor/ceil combinations
+        float bestDot = -2.0f;
+        for (int corner = 0; corner < 4; corner++)
+        {
+            float x = (corner & 1 ? std::ceil(encoded.x * 32767.0f) : std::floor(encoded.x * 32767.0f)) / 32767.0f;
+            float y = (corner & 2 ? std::ceil(encoded.y * 32767.0f) : std::floor(encoded.y * 32767.0f)) / 32767.0f;
+
+            uint16_t candidate[2] = { glm::packSnorm1x16(x), glm::packSnorm1x16(y) };
+            glm::vec3 decoded = VertexQuantizer::decodeOctahedral(glm::vec2(glm::unpackSnorm1x16(candidate[0]),
+                                                                            glm::unpackSnorm1x16(candidate[1])));
+            float similarity = glm::dot(decoded, normal);
+            if (similarity > bestDot)
+            {
+                bestDot = similarity;
+                packed[0] = candidate[0];
+                packed[1] = candidate[1];
+            }
+        }
+    }
+}
+
+glm::vec2 VertexQuantizer::encodeOctahedral(const glm::vec3& normal)
+{
+    // Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half over the upper
+    glm::vec2 projected = glm::vec2(normal.x, normal.y) * (1.0f / (std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z)));
+    if (normal.z >= 0.0f) return projected;
+
+    return glm::vec2((1.0f - std::fabs(projected.y)) * signNotZero(projected.x),
+                     (1.0f - std::fabs(projected.x)) * signNotZero(projected.y));
+}
+
+glm::vec3 VertexQuantizer::decodeOctahedral(const glm::vec2& encoded)
+{
+    glm::vec3 normal(encoded.x, encoded.y, 1.0f - std::fabs(encoded.x) - std::fabs(encoded.y));
+    if (normal.z < 0.0f)
+    {
+        float x = normal.x;
+        normal.x = (1.0f - std::fabs(normal.y)) * signNotZero(x);
+        normal.y = (1.0f - std::fabs(x)) * signNotZero(normal.y);
+    }
+
+    return glm::normalize(normal);
+}
+
+QuantizedVertices VertexQuantizer::quantize(const glm::vec3* positions, const glm::vec3* normals, const glm::vec2* texCoords,
+                                            unsigned int vertexCount, PositionEncoding encoding)
+{
+    QuantizedVertices result;
+    result.vertexCount = vertexCount;
+    result.sourceSize = (size_t) vertexCount * (sizeof(glm::vec3) + (normals ? sizeof(glm::vec3) : 0) + (texCoords ? sizeof(glm::vec2) : 0));
+
+    if (encoding == PositionEncoding::Float) result.layout.add(PositionAttribute, 3, GL_FLOAT);
+    else if (encoding == PositionEncoding::Half) result.layout.add(PositionAttribute, 3, GL_HALF_FLOAT);
+    else result.layout.add(PositionAttribute, 3, GL_SHORT, true);
+    if (normals != nullptr) result.layout.add(NormalAttribute, 2, GL_SHORT, true);
+    if (texCoords != nullptr) result.layout.add(TexCoordAttribute, 2, GL_UNSIGNED_SHORT, true);
+
+    // Bounds of the positions and UVs; positions use the largest half-extent on every axis
+    glm::vec3 lower(0.0f), upper(0.0f);
+    glm::vec2 uvLower(0.0f), uvUpper(1.0f);
+    if (vertexCount > 0)
+    {
+        lower = upper = positions[0];
+        for (unsigned int i = 1; i < vertexCount; i++)
+        {
+            lower = glm::min(lower, positions[i]);
+            upper = glm::max(upper, positions[i]);
+        }
+
+        if (texCoords != nullptr)
+        {
+            uvLower = uvUpper = texCoords[0];
+            for (unsigned int i = 1; i < vertexCount; i++)
+            {
+                uvLower = glm::min(uvLower, texCoords[i]);
+                uvUpper = glm::max(uvUpper, texCoords[i]);
+            }
+        }
+    }
+
+    glm::vec3 center = (lower + upper) * 0.5f;
+    glm::vec3 halfExtent = (upper - lower) * 0.5f;
+    float scale = std::max({ halfExtent.x, halfExtent.y, halfExtent.z, 1e-20f });
+    glm::vec2 uvScale = glm::max(uvUpper - uvLower, glm::vec2(1e-20f));
+
+    if (encoding != PositionEncoding::Float)
+    {
+        result.positionTransform = glm::mat4(1.0f);
+        result.positionTransform[0][0] = result.positionTransform[1][1] = result.positionTransform[2][2] = scale;
+        result.positionTransform[3] = glm::vec4(center, 1.0f);
+    }
+    result.texCoordTransform = glm::vec4(uvLower.x, uvLower.y, uvScale.x, uvScale.y);
+
+    const unsigned int stride = result.layout.getStride();
+    const unsigned int normalOffset = normals ? result.layout.find(NormalAttribute)->offset : 0;
+    const unsigned int texCoordOffset = texCoords ? result.layout.find(TexCoordAttribute)->offset : 0;
+    result.data.assign((size_t) stride * vertexCount, 0);
+
+    for (unsigned int i = 0; i < vertexCount; i++)
+    {
+        unsigned char* vertex = result.data.data() + (size_t) stride * i;
+
+        // Encode, then decode again to measure what the GPU will actually see
+        glm::vec3 decoded;
+        if (encoding == PositionEncoding::Float)
+        {
+            std::memcpy(vertex, &positions[i], sizeof(glm::vec3));
+            decoded = positions[i];
+        }
+        else
+        {
+            glm::vec3 normalized = (positions[i] - center) / scale;
+            uint16_t packed[3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                if (encoding == PositionEncoding::Half)
+                {
+                    packed[axis] = glm::packHalf1x16(normalized[axis]);
+                    decoded[axis] = glm::unpackHalf1x16(packed[axis]);
+                }
+                else
+                {
+                    packed[axis] = glm::packSnorm1x16(normalized[axis]);
+                    decoded[axis] = glm::unpackSnorm1x16(packed[axis]);
+                }
+            }
+            std::memcpy(vertex, packed, sizeof(packed));
+            decoded = center + decoded * scale;
+        }
+        result.maxPositionError = std::max(result.maxPositionError, glm::length(decoded - positions[i]));
+
+        if (normals != nullptr)
+        {
+            glm::vec3 normal = glm::normalize(normals[i]);
+            uint16_t packed[2];
+            packNormal(normal, packed);
+            std::memcpy(vertex + normalOffset, packed, sizeof(packed));
+
+            glm::vec3 decodedNormal = decodeOctahedral(glm::vec2(glm::unpackSnorm1x16(packed[0]), glm::unpackSnorm1x16(packed[1])));
+            // atan2 stays accurate for tiny angles, where acos of a dot product near 1 loses everything to rounding
+            float angle = std::atan2(glm::length(glm::cross(decodedNormal, normal)), glm::dot(decodedNormal, normal)) * 180.0f / std::numbers::pi_v<float>;
+            result.maxNormalError = std::max(result.maxNormalError, angle);
+        }
+
+        if (texCoords != nullptr)
+        {
+            glm::vec2 normalized = (texCoords[i] - uvLower) / uvScale;
+            uint16_t packed[2] = { glm::packUnorm1x16(normalized.x), glm::packUnorm1x16(normalized.y) };
+            std::memcpy(vertex + texCoordOffset, packed, sizeof(packed));
+
+            glm::vec2 decodedUV = uvLower + glm::vec2(glm::unpackUnorm1x16(packed[0]), glm::unpackUnorm1x16(packed[1])) * uvScale;
+            glm::vec2 error = glm::abs(decodedUV - texCoords[i]);
+            result.maxTexCoordError = std::max({ result.maxTexCoordError, error.x, error.y });
+        }
+    }
+
+    return result;
+}
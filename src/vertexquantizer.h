@@ -0,0 +1,56 @@
+//
+// Compressed vertex formats
+//
+
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "vertexlayout.h"
+
+enum class PositionEncoding
+{
+    Float,      // 3x float, unchanged (12 bytes)
+    Half,       // 3x half float of the normalized position (8 bytes with padding)
+    Snorm16     // 3x normalized short of the normalized position (8 bytes with padding)
+};
+
+// Interleaved, quantized vertices ready for Mesh::create(data, vertexCount, indices, indexCount, layout)
+struct QuantizedVertices
+{
+    std::vector<unsigned char> data;
+    unsigned int vertexCount = 0;
+    VertexLayout layout;
+
+    // Decoded positions lie in [-1, 1]; multiply this into the model matrix to get back to model space.
+    // The scale is uniform so normals can still be transformed with the model matrix
+    glm::mat4 positionTransform {1.0f};
+
+    // For the uvTransform uniform of Shaders/quantized.vertex: xy = offset, zw = scale
+    glm::vec4 texCoordTransform {0.0f, 0.0f, 1.0f, 1.0f};
+
+    // Largest errors measured by decoding every vertex again: model-space distance, degrees, UV units
+    float maxPositionError = 0.0f, maxNormalError = 0.0f, maxTexCoordError = 0.0f;
+    size_t sourceSize = 0;      // Bytes the same vertices take as floats, for comparison
+};
+
+/* Quantizes positions (optionally with normals and UVs) into a compact interleaved layout:
+ * positions relative to their bounding box as half floats or snorm16, normals octahedrally encoded
+ * into 2x snorm16 and UVs as unorm16 relative to their range. Position, normal and UV together go
+ * from 32 to 16 bytes per vertex. Shaders/quantized.vertex decodes the normals and UVs; positions
+ * need nothing beyond positionTransform.
+ */
+class VertexQuantizer
+{
+public:
+    VertexQuantizer() = delete;
+
+    // normals and texCoords may be null
+    static QuantizedVertices quantize(const glm::vec3* positions, const glm::vec3* normals, const glm::vec2* texCoords,
+                                      unsigned int vertexCount, PositionEncoding encoding = PositionEncoding::Snorm16);
+
+    // Octahedral mapping of a unit vector onto [-1, 1]^2 (Cigolle et al. 2014), and back
+    static glm::vec2 encodeOctahedral(const glm::vec3& normal);
+    static glm::vec3 decodeOctahedral(const glm::vec2& encoded);
+};
@@ -0,0 +1,228 @@
+//
+// Vertex deduplication for imported meshes
+//
+
+#include "vertexwelder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr int groupSize = 16;
+    constexpr int8_t emptyControl = (int8_t) 0x80;
+
+    /* Open addressing in groups of 16 slots. Each slot has a control byte holding 7 bits of its
+     * hash (or emptyControl), so one SSE2 compare checks a whole group for candidates before any
+     * vertex data is touched. Groups are probed triangularly, which visits every group once. */
+    class VertexTable
+    {
+    private:
+        std::vector<int8_t> m_Control;
+        std::vector<unsigned int> m_Vertices;
+        size_t m_GroupMask;
+
+        // Bit i set where control byte i of the group equals value / is empty
+        static unsigned int matchGroup(const int8_t* control, int8_t value)
+        {
+#ifdef __SSE2__
+            __m128i group = _mm_loadu_si128((const __m128i*) control);
+            return (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value)));
+#else
+            unsigned int mask = 0;
+            for (int i = 0; i < groupSize; i++) mask |= (unsigned int) (control[i] == value) << i;
+            return mask;
+#endif
+        }
+
+        static unsigned int emptyInGroup(const int8_t* control)
+        {
+#ifdef __SSE2__
+            // Only empty slots have the sign bit set
+            return (unsigned int) _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) control));
+#else
+            return matchGroup(control, emptyControl);
+#endif
+        }
+
+        static int8_t controlByte(uint64_t hash) { return (int8_t) (hash >> 57); }
+    public:
+        explicit VertexTable(size_t capacity)
+        {
+            // Keep the load factor under 7/8 so probes end quickly
+            size_t groups = 1;
+            while (groups * groupSize * 7 / 8 < capacity) groups *= 2;
+
+            m_Control.assign(groups * groupSize, emptyControl);
+            m_Vertices.assign(groups * groupSize, 0);
+            m_GroupMask = groups - 1;
+        }
+
+        // Calls matches(vertex) for every stored vertex whose hash may equal this one until it returns true
+        template<typename Predicate>
+        bool find(uint64_t hash, Predicate matches, unsigned int& found) const
+        {
+            int8_t control = controlByte(hash);
+            size_t group = hash & m_GroupMask;
+            for (size_t probe = 1; ; probe++)
+            {
+                const int8_t* groupControl = m_Control.data() + group * groupSize;
+                for (unsigned int mask = matchGroup(groupControl, control); mask != 0; mask &= mask - 1)
+                {
+                    unsigned int vertex = m_Vertices[group * groupSize + __builtin_ctz(mask)];
+                    if (matches(vertex))
+                    {
+                        found = vertex;
+                        return true;
+                    }
+                }
+
+                if (emptyInGroup(groupControl) != 0 || probe > m_GroupMask) return false;
+                group = (group + probe) & m_GroupMask;
+            }
+        }
+
+        void insert(uint64_t hash, unsigned int vertex)
+        {
+            size_t group = hash & m_GroupMask;
+            for (size_t probe = 1; ; probe++)
+            {
+                int8_t* groupControl = m_Control.data() + group * groupSize;
+                unsigned int empty = emptyInGroup(groupControl);
+                if (empty != 0)
+                {
+                    int slot = __builtin_ctz(empty);
+                    groupControl[slot] = controlByte(hash);
+                    m_Vertices[group * groupSize + slot] = vertex;
+                    return;
+                }
+                group = (group + probe) & m_GroupMask;
+            }
+        }
+    };
+
+    // Word-at-a-time multiply/rotate hash; FNV-1a's byte loop is too slow for millions of vertices
+    uint64_t hashBytes(const unsigned char* data, size_t size, uint64_t hash = 0x9E3779B97F4A7C15ull)
+    {
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            hash = (hash ^ (word * 0xBF58476D1CE4E5B9ull)) * 0x94D049BB133111EBull;
+            hash ^= hash >> 31;
+        }
+        for (; i < size; i++) hash = (hash ^ data[i]) * 0x100000001B3ull;
+
+        hash ^= hash >> 29;
+        hash *= 0xBF58476D1CE4E5B9ull;
+        return hash ^ (hash >> 32);
+    }
+
+    uint64_t hashCell(const int32_t cell[3], uint64_t attributeHash)
+    {
+        return hashBytes((const unsigned char*) cell, sizeof(int32_t) * 3, attributeHash);
+    }
+}
+
+size_t VertexWelder::weld(void* vertices, size_t vertexStride, size_t vertexCount, unsigned int* indices, size_t indexCount,
+                          size_t positionOffset, float epsilon)
+{
+    auto* data = (unsigned char*) vertices;
+    auto vertexAt = [&](size_t vertex) { return data + vertexStride * vertex; };
+
+    // Everything but the position must match exactly, even when positions are welded with a tolerance
+    auto attributesEqual = [&](const unsigned char* a, const unsigned char* b)
+    {
+        return std::memcmp(a, b, positionOffset) == 0 &&
+               std::memcmp(a + positionOffset + 12, b + positionOffset + 12, vertexStride - positionOffset - 12) == 0;
+    };
+
+    auto readPosition = [&](const unsigned char* vertex, float position[3]) { std::memcpy(position, vertex + positionOffset, 12); };
+
+    VertexTable table(vertexCount);
+    std::vector<unsigned int> remap(vertexCount);
+    size_t uniqueCount = 0;
+
+    for (size_t vertex = 0; vertex < vertexCount; vertex++)
+    {
+        const unsigned char* source = vertexAt(vertex);
+        unsigned int found;
+        bool merged;
+        uint64_t insertHash;
+
+        if (epsilon <= 0.0f)
+        {
+            insertHash = hashBytes(source, vertexStride);
+            merged = table.find(insertHash, [&](unsigned int candidate)
+            {
+                return std::memcmp(vertexAt(candidate), source, vertexStride) == 0;
+            }, found);
+        }
+        else
+        {
+            // Hash the grid cell plus the other attributes. Cells are 2 * epsilon wide, so a match
+            // within epsilon is either in this cell or in the nearer neighbour along each axis
+            float position[3];
+            readPosition(source, position);
+            uint64_t attributeHash = hashBytes(source, positionOffset) ^ hashBytes(source + positionOffset + 12, vertexStride - positionOffset - 12);
+
+            int32_t cell[3], neighbour[3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float scaled = std::clamp(position[axis] / (2.0f * epsilon), -1e9f, 1e9f);
+                cell[axis] = (int32_t) std::floor(scaled);
+                neighbour[axis] = scaled - (float) cell[axis] < 0.5f ? cell[axis] - 1 : cell[axis] + 1;
+            }
+            insertHash = hashCell(cell, attributeHash);
+
+            auto withinEpsilon = [&](unsigned int candidate)
+            {
+                const unsigned char* other = vertexAt(candidate);
+                float otherPosition[3];
+                readPosition(other, otherPosition);
+                for (int axis = 0; axis < 3; axis++)
+                    if (std::fabs(otherPosition[axis] - position[axis]) > epsilon) return false;
+                return attributesEqual(other, source);
+            };
+
+            merged = false;
+            for (int corner = 0; corner < 8 && !merged; corner++)
+            {
+                int32_t probe[3];
+                for (int axis = 0; axis < 3; axis++) probe[axis] = corner & (1 << axis) ? neighbour[axis] : cell[axis];
+                merged = table.find(hashCell(probe, attributeHash), withinEpsilon, found);
+            }
+        }
+
+        if (merged)
+        {
+            remap[vertex] = remap[found];
+            continue;
+        }
+
+        // Unique so far: it stays, moved down into the compacted prefix. Table entries refer to
+        // original positions, which the compaction never overwrites before they are read
+        remap[vertex] = (unsigned int) uniqueCount++;
+        table.insert(insertHash, (unsigned int) vertex);
+    }
+
+    // Compact afterwards so candidates above are always read from their original slots
+    std::vector<bool> kept(vertexCount, false);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++)
+    {
+        if (kept[remap[vertex]]) continue;
+        kept[remap[vertex]] = true;
+        if (remap[vertex] != vertex) std::memmove(vertexAt(remap[vertex]), vertexAt(vertex), vertexStride);
+    }
+
+    for (size_t i = 0; i < indexCount; i++) indices[i] = remap[indices[i]];
+    return uniqueCount;
+}
@@ -0,0 +1,28 @@
+//
+// Vertex deduplication for imported meshes
+//
+
+#pragma once
+#include <cstddef>
+
+/* Merges duplicate vertices and rewrites the indices that reference them, turning triangle soups
+ * (STL, naively exported OBJ, ...) into properly indexed meshes with smaller vertex buffers and
+ * post-transform cache hits across shared corners.
+ *
+ * With epsilon = 0, vertices merge only if all their bytes are equal. Otherwise positions (three
+ * floats at positionOffset) merge when every component is within epsilon, as long as every other
+ * byte of the vertex matches, so seams in normals or UVs survive.
+ *
+ * Lookups go through an open-addressing hash table probed 16 slots at a time with SSE2 (a scalar
+ * loop elsewhere), keyed on the vertex bytes or, for epsilon welding, the position's grid cell.
+ */
+class VertexWelder
+{
+public:
+    VertexWelder() = delete;
+
+    // Compacts vertices in place (first occurrences keep their relative order), rewrites indices,
+    // and returns the new vertex count
+    static size_t weld(void* vertices, size_t vertexStride, size_t vertexCount, unsigned int* indices, size_t indexCount,
+                       size_t positionOffset = 0, float epsilon = 0.0f);
+};
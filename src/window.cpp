@@ -3,43 +3,75 @@
 //
 
 #include "window.h"
+#include "statecache.h"
+#include "trace.h"
 
 #include <iostream>
+#include <cstring>
 
-GLWindow::GLWindow() : m_BufferWidth(800), m_BufferHeight(600)
-{
-    m_Window = glfwCreateWindow((int) m_BufferWidth, (int) m_BufferHeight, "OpenGL Practice", nullptr, nullptr);
+// Keep Xlib out of the EGL headers; the surfaceless platform does not need it
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 
-    // Return if the main GLFW window cannot be created
-    if (m_Window == nullptr)
-    {
-        std::cout << "Could not create main GLFW window\n";
-        glfwTerminate();
-        return;
-    }
-}
+GLWindow::GLWindow() : m_BufferWidth(800), m_BufferHeight(600)
+{}
 
 GLWindow::GLWindow(float width, float height) : m_BufferWidth(width), m_BufferHeight(height)
-{
-    m_Window = glfwCreateWindow((int) m_BufferWidth, (int) m_BufferHeight, "OpenGL Practice", nullptr, nullptr);
+{}
 
-    // Return if the main GLFW window cannot be created
-    if (m_Window == nullptr)
+GLWindow::GLWindow(float width, float height, WindowBackend backend)
+    : m_Backend(backend), m_BufferWidth(width), m_BufferHeight(height)
+{}
+
+GLWindow::~GLWindow()
+{
+    if (isHeadless())
     {
-        std::cout << "Could not create main GLFW window\n";
-        glfwTerminate();
+        if (m_EGLContext != nullptr)
+        {
+            GLStateCache::forgetFramebuffer(m_FBO);
+            if (m_FBO != 0) glDeleteFramebuffers(1, &m_FBO);
+            if (m_ColorRBO != 0) glDeleteRenderbuffers(1, &m_ColorRBO);
+            if (m_DepthRBO != 0) glDeleteRenderbuffers(1, &m_DepthRBO);
+
+            eglMakeCurrent(m_EGLDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(m_EGLDisplay, m_EGLContext);
+        }
+
+        if (m_EGLDisplay != nullptr) eglTerminate(m_EGLDisplay);
         return;
     }
-}
 
-GLWindow::~GLWindow()
-{
-    glfwDestroyWindow(m_Window);
+    if (m_Window != nullptr) glfwDestroyWindow(m_Window);
     glfwTerminate();
 }
 
 int GLWindow::init()
 {
+    int result = isHeadless() ? initHeadless() : initGLFW();
+    if (result != 0) return result;
+
+    result = initGLEW();
+    if (result != 0) return result;
+
+    // Headless rendering has no default framebuffer to draw into
+    if (isHeadless()) return createFramebuffer();
+    return 0;
+}
+
+int GLWindow::initGLFW()
+{
+    // Initialize GLFW
+    if (!glfwInit())
+    {
+        std::cout << "GLFW failed to initialize\n";
+
+        // Unload GLFW memory
+        glfwTerminate();
+        return 1;
+    }
+
     // Setup GLFW window properties
     // OpenGL version
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -49,12 +81,172 @@ int GLWindow::init()
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, true);
 
-    // Get buffer size information
+    // Hints only apply to windows created after they are set
+    m_Window = glfwCreateWindow((int) m_BufferWidth, (int) m_BufferHeight, "OpenGL Practice", nullptr, nullptr);
+
+    // Return if the main GLFW window cannot be created
+    if (m_Window == nullptr)
+    {
+        std::cout << "Could not create main GLFW window\n";
+        return 1;
+    }
+
+    // Get buffer size information (differs from the window size on high-DPI displays)
     int bufferWidth, bufferHeight;
     glfwGetFramebufferSize(m_Window, &bufferWidth, &bufferHeight);
+    m_BufferWidth = (float) bufferWidth;
+    m_BufferHeight = (float) bufferHeight;
 
     // Set context for GLEW to use
     glfwMakeContextCurrent(m_Window);
 
     return 0;
-}
\ No newline at end of file
+}
+
+int GLWindow::initHeadless()
+{
+    // Prefer Mesa's surfaceless platform, which needs neither a display server nor a GPU (llvmpipe)
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    EGLDisplay display = EGL_NO_DISPLAY;
+    if (getPlatformDisplay != nullptr)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+    {
+        std::cout << "Could not initialize EGL display\n";
+        return 1;
+    }
+    m_EGLDisplay = display;
+
+    const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (extensions == nullptr || !strstr(extensions, "EGL_KHR_surfaceless_context"))
+    {
+        std::cout << "EGL display does not support surfaceless contexts\n";
+        return 1;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        std::cout << "EGL does not support desktop OpenGL\n";
+        return 1;
+    }
+
+    // A context without a config is enough since we never create an EGL surface
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    if (!strstr(extensions, "EGL_KHR_no_config_context"))
+    {
+        const EGLint configAttributes[] = {
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_NONE
+        };
+
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+        {
+            std::cout << "Could not find an EGL config for OpenGL\n";
+            return 1;
+        }
+    }
+
+    // Same context version as the GLFW backend: 3.3 core
+    const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+    };
+
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT)
+    {
+        std::cout << "Could not create EGL context (error 0x" << std::hex << eglGetError() << std::dec << ")\n";
+        return 1;
+    }
+    m_EGLContext = context;
+
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        std::cout << "Could not make EGL context current\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+int GLWindow::initGLEW()
+{
+    // Allow modern extension features
+    glewExperimental = true;
+
+    // GLEW builds without EGL support report a missing GLX display, but still load the GL entry points
+    GLenum result = glewInit();
+    if (result != GLEW_OK && !(isHeadless() && result == GLEW_ERROR_NO_GLX_DISPLAY))
+    {
+        std::cout << "Could not initialize GLEW: " << glewGetErrorString(result) << '\n';
+        return 1;
+    }
+
+    // glewInit() may leave a GL error behind on core contexts
+    glGetError();
+    return 0;
+}
+
+int GLWindow::createFramebuffer()
+{
+    glGenRenderbuffers(1, &m_ColorRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_ColorRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, (int) m_BufferWidth, (int) m_BufferHeight);
+
+    glGenRenderbuffers(1, &m_DepthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_DepthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, (int) m_BufferWidth, (int) m_BufferHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_FBO);
+    GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_ColorRBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_DepthRBO);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "Offscreen framebuffer is incomplete\n";
+        return 1;
+    }
+
+    // Leave the FBO bound so callers draw into it exactly as they would into a window
+    return 0;
+}
+
+void GLWindow::setVSync(bool enabled)
+{
+    // There is no display to synchronize with when headless
+    if (!isHeadless()) glfwSwapInterval(enabled ? 1 : 0);
+}
+
+bool GLWindow::shouldClose()
+{
+    if (m_FrameLimit != 0 && m_FrameCount >= m_FrameLimit) return true;
+    return !isHeadless() && glfwWindowShouldClose(m_Window);
+}
+
+void GLWindow::swapBuffers()
+{
+    TRACE_SCOPE("GLWindow::swapBuffers");
+    m_FrameCount++;
+
+    // Nothing to present offscreen; flush so queued frames don't pile up in the driver
+    if (isHeadless())
+    {
+        glFlush();
+        return;
+    }
+    glfwSwapBuffers(m_Window);
+}
+
+void GLWindow::pollEvents()
+{
+    if (!isHeadless()) glfwPollEvents();
+}
@@ -6,20 +6,47 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+enum class WindowBackend
+{
+    GLFW,       // On-screen window with a GLFW-managed context
+    Headless    // EGL surfaceless context that renders into an offscreen framebuffer
+};
+
 class GLWindow
 {
 public:
     GLWindow();
     GLWindow(float width, float height);
+    GLWindow(float width, float height, WindowBackend backend);
     ~GLWindow();
 private:
+    WindowBackend m_Backend = WindowBackend::GLFW;
     GLFWwindow* m_Window = nullptr;
     float m_BufferWidth, m_BufferHeight;
+
+    // Headless state (EGL handles are kept opaque so EGL headers stay out of this file)
+    void* m_EGLDisplay = nullptr;
+    void* m_EGLContext = nullptr;
+    unsigned int m_FBO = 0, m_ColorRBO = 0, m_DepthRBO = 0;
+    unsigned int m_FrameCount = 0, m_FrameLimit = 0;
+private:
+    int initGLFW();
+    int initHeadless();
+    int initGLEW();
+    int createFramebuffer();
 public:
     constexpr float getBufferWidth() const { return m_BufferWidth; }
     constexpr float getBufferHeight() const { return m_BufferHeight; }
+    constexpr bool isHeadless() const { return m_Backend == WindowBackend::Headless; }
+    constexpr unsigned int getFramebuffer() const { return m_FBO; }
+    constexpr unsigned int getFrameCount() const { return m_FrameCount; }
+
+    // shouldClose() reports true once this many frames were swapped (0 = never)
+    void setFrameLimit(unsigned int frames) { m_FrameLimit = frames; }
 
     int init();
-    bool shouldClose() { return glfwWindowShouldClose(m_Window); }
-    void swapBuffers() { return glfwSwapBuffers(m_Window); }
-};
\ No newline at end of file
+    void setVSync(bool enabled);
+    bool shouldClose();
+    void swapBuffers();
+    void pollEvents();
+};
@@ -0,0 +1,526 @@
+//
+// Golden-image regression tests: renders canonical scenes headless and compares them to reference PNGs
+//
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <numbers>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "window.h"
+#include "mesh.h"
+#include "meshpool.h"
+#include "shader.h"
+#include "statecache.h"
+#include "renderqueue.h"
+#include "uniformbuffer.h"
+#include "readback.h"
+#include "image.h"
+#include "vertexquantizer.h"
+#include "modelloader.h"
+#include "gltfloader.h"
+
+namespace
+{
+    const char* vertexShader = SHADER_DIR "shader.vertex";
+    const char* instancedVertexShader = SHADER_DIR "instanced.vertex";
+    const char* quantizedVertexShader = SHADER_DIR "quantized.vertex";
+    const char* fragmentShader = SHADER_DIR "shader.fragment";
+
+    /* Loader fixtures in tests/models:
+     *   cube.obj        quads and a pentagon (fans), negative indices, CRLF lines, a duplicated vertex
+     *   octahedron.ply  little endian, triangles only (parallel path), extra properties and elements
+     *   prism.ply       big endian, doubles, quad faces and an extra face property (in-order path)
+     *   scene.glb       one mesh, two primitives: interleaved position and normal with 16-bit indices
+     *                   (zero copy), and positions and unorm16 UVs in separate views with 8-bit indices
+     *                   (staged, indices widened); three instances in a two-level node hierarchy */
+    const char* cubeModel = MODEL_DIR "cube.obj";
+    const char* octahedronModel = MODEL_DIR "octahedron.ply";
+    const char* prismModel = MODEL_DIR "prism.ply";
+    const char* gltfModel = MODEL_DIR "scene.glb";
+
+    constexpr unsigned int imageWidth = 320, imageHeight = 240;
+
+    // The tetrahedron from main.cpp's createObjects()
+    unsigned int tetrahedronIndices[] = {
+            0, 3, 1,
+            1, 3, 2,
+            2, 3, 0,
+            0, 1, 2
+    };
+
+    float tetrahedronVertices[] = {
+            -1.0f, -1.0f, 0.0f,
+            0.0f, -1.0f, 1.0f,
+            1.0f, -1.0f, 0.0f,
+            1.0f, 1.0f, 0.0f
+    };
+
+    struct Resources
+    {
+        Mesh tetrahedron, sphere;
+        MeshPool pool;
+        QuantizedVertices sphereVertices;
+        ImportedModel cube, octahedron, prism;
+        GltfModel gltf;
+        Shader shader, instancedShader, quantizedShader;
+        RenderQueue queue;
+        UniformBuffer uniforms;
+        FrameUniforms frame;
+    };
+
+    // main.cpp's first frame: initial scene state, so the clear colour is phase 0 of its colour cycle
+    void renderTetrahedron(Resources& resources)
+    {
+        auto r = (float) std::abs(std::sin(2 * std::numbers::pi / 3));
+        auto b = (float) std::abs(std::sin(-2 * std::numbers::pi / 3));
+        glClearColor(r, 0.0f, b, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glm::mat4 model(1.0f);
+        model = glm::scale(model, glm::vec3(3.0f, 3.0f, 3.0f));
+        model = glm::translate(model, glm::vec3(-3.0f, 0.0f, -10.0f));
+
+        DrawPacket packet;
+        packet.mesh = &resources.tetrahedron;
+        packet.shader = &resources.shader;
+        packet.transform = model;
+        packet.depth = -model[3].z;
+        resources.queue.submit(packet);
+
+        resources.uniforms.setFrame(resources.frame);
+        resources.queue.dispatch(resources.uniforms);
+        resources.queue.clear();
+        resources.uniforms.endFrame();
+    }
+
+    // A 4x4 grid of rotated tetrahedra drawn with one instanced call
+    void renderInstanced(Resources& resources)
+    {
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        std::vector<glm::mat4> transforms;
+        for (int i = 0; i < 16; i++)
+        {
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(-3.0f + 2.0f * (float) (i % 4),
+                                                                            -3.0f + 2.0f * (float) (i / 4), -12.0f));
+            transform = glm::rotate(transform, glm::radians(22.5f * (float) i), glm::vec3(0.0f, 1.0f, 0.0f));
+            transforms.push_back(glm::scale(transform, glm::vec3(0.7f)));
+        }
+
+        resources.uniforms.setFrame(resources.frame);
+        unsigned int first = resources.uniforms.beginObjects(1);
+        resources.uniforms.setObject(first, ObjectUniforms());
+        resources.uniforms.endObjects();
+        resources.uniforms.bindObject(first);
+
+        resources.instancedShader.use();
+        resources.tetrahedron.setInstances(transforms.data(), (unsigned int) transforms.size());
+        resources.tetrahedron.renderInstanced((unsigned int) transforms.size());
+        resources.uniforms.endFrame();
+    }
+
+    // Several tetrahedra at different depths from one mesh pool multi-draw
+    void renderPool(Resources& resources)
+    {
+        glClearColor(0.0f, 0.2f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        resources.uniforms.setFrame(resources.frame);
+        unsigned int first = resources.uniforms.beginObjects(1);
+        resources.uniforms.setObject(first, ObjectUniforms { glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -8.0f)) });
+        resources.uniforms.endObjects();
+        resources.uniforms.bindObject(first);
+
+        resources.shader.use();
+        resources.pool.render();
+        resources.uniforms.endFrame();
+    }
+
+    // A UV sphere stored with snorm16 positions, octahedral normals and unorm16 UVs
+    void renderQuantized(Resources& resources)
+    {
+        glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -6.0f));
+        model = glm::rotate(model, glm::radians(30.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        model = model * resources.sphereVertices.positionTransform;
+
+        resources.uniforms.setFrame(resources.frame);
+        unsigned int first = resources.uniforms.beginObjects(1);
+        resources.uniforms.setObject(first, ObjectUniforms { model });
+        resources.uniforms.endObjects();
+        resources.uniforms.bindObject(first);
+
+        resources.quantizedShader.setUniform("uvTransform", resources.sphereVertices.texCoordTransform);
+        resources.sphere.render();
+        resources.uniforms.endFrame();
+    }
+
+    // The OBJ cube after welding, reordering and quantization, lit and checkered by its UVs
+    void renderObj(Resources& resources)
+    {
+        glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -7.0f));
+        model = glm::rotate(model, glm::radians(30.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        model = glm::rotate(model, glm::radians(40.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = model * resources.cube.positionTransform;
+
+        resources.uniforms.setFrame(resources.frame);
+        unsigned int first = resources.uniforms.beginObjects(1);
+        resources.uniforms.setObject(first, ObjectUniforms { model });
+        resources.uniforms.endObjects();
+        resources.uniforms.bindObject(first);
+
+        resources.quantizedShader.setUniform("uvTransform", resources.cube.texCoordTransform);
+        resources.cube.mesh->render();
+        resources.uniforms.endFrame();
+    }
+
+    // Both PLY fixtures, unquantized, coloured by position
+    void renderPly(Resources& resources)
+    {
+        glClearColor(0.2f, 0.2f, 0.25f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        const ImportedModel* models[] = { &resources.octahedron, &resources.prism };
+        for (int i = 0; i < 2; i++)
+        {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(-1.6f + 3.2f * (float) i, 0.0f, -7.0f));
+            model = glm::rotate(model, glm::radians(35.0f), glm::vec3(1.0f, 1.0f, 0.0f));
+
+            DrawPacket packet;
+            packet.mesh = models[i]->mesh.get();
+            packet.shader = &resources.shader;
+            packet.transform = model;
+            packet.depth = -model[3].z;
+            resources.queue.submit(packet);
+        }
+
+        resources.uniforms.setFrame(resources.frame);
+        resources.queue.dispatch(resources.uniforms);
+        resources.queue.clear();
+        resources.uniforms.endFrame();
+    }
+
+    // Every primitive of every glTF instance, placed by its node's world transform
+    void renderGltf(Resources& resources)
+    {
+        glClearColor(0.1f, 0.15f, 0.2f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.3f, -9.0f));
+        view = glm::rotate(view, glm::radians(20.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        for (const GltfInstance& instance : resources.gltf.instances)
+        {
+            for (const GltfPrimitive& primitive : resources.gltf.meshes[instance.mesh].primitives)
+            {
+                DrawPacket packet;
+                packet.mesh = primitive.mesh.get();
+                packet.shader = &resources.shader;
+                packet.transform = view * instance.transform;
+                packet.depth = -packet.transform[3].z;
+                resources.queue.submit(packet);
+            }
+        }
+
+        resources.uniforms.setFrame(resources.frame);
+        resources.queue.dispatch(resources.uniforms);
+        resources.queue.clear();
+        resources.uniforms.endFrame();
+    }
+
+    // Loads the glb fixture and checks which upload path each primitive took
+    bool loadGltf(Resources& resources)
+    {
+        if (!GltfLoader::loadGLB(gltfModel, resources.gltf)) return false;
+
+        const GltfModel& model = resources.gltf;
+        bool expected = model.meshes.size() == 1 && model.meshes[0].primitives.size() == 2 &&
+                        model.instances.size() == 3;
+        if (expected)
+        {
+            const GltfPrimitive& interleaved = model.meshes[0].primitives[0];
+            const GltfPrimitive& split = model.meshes[0].primitives[1];
+            expected = interleaved.zeroCopy && interleaved.mesh->getIndexType() == GL_UNSIGNED_SHORT &&
+                       !split.zeroCopy && split.mesh->getIndexType() == GL_UNSIGNED_SHORT;
+        }
+        if (expected) return true;
+
+        std::cout << gltfModel << ": unexpected meshes, upload paths or instances\n";
+        return false;
+    }
+
+    // Loads a fixture and checks the vertex and index counts left after welding
+    bool importModel(const char* path, const ModelImportOptions& options, unsigned int vertexCount,
+                     unsigned int indexCount, ImportedModel& model)
+    {
+        if (!ModelLoader::import(path, model, options)) return false;
+        if (model.vertexCount == vertexCount && model.indexCount == indexCount) return true;
+
+        std::cout << path << ": expected " << vertexCount << " vertices and " << indexCount << " indices, got "
+                  << model.vertexCount << " and " << model.indexCount << '\n';
+        return false;
+    }
+
+    void createSphere(Resources& resources)
+    {
+        constexpr unsigned int rings = 24, segments = 48;
+        std::vector<glm::vec3> positions, normals;
+        std::vector<glm::vec2> texCoords;
+        std::vector<unsigned int> indices;
+
+        for (unsigned int ring = 0; ring <= rings; ring++)
+        {
+            for (unsigned int segment = 0; segment <= segments; segment++)
+            {
+                float u = (float) segment / segments, v = (float) ring / rings;
+                float theta = u * 2.0f * std::numbers::pi_v<float>, phi = v * std::numbers::pi_v<float>;
+                glm::vec3 normal(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+
+                // Off-centre and stretched UVs exercise the bounds remapping
+                positions.push_back(normal * 1.5f + glm::vec3(0.25f, 0.0f, 0.0f));
+                normals.push_back(normal);
+                texCoords.push_back(glm::vec2(u * 2.0f - 0.5f, v));
+            }
+        }
+
+        for (unsigned int ring = 0; ring < rings; ring++)
+        {
+            for (unsigned int segment = 0; segment < segments; segment++)
+            {
+                unsigned int corner = ring * (segments + 1) + segment;
+                indices.insert(indices.end(), { corner, corner + segments + 1, corner + 1,
+                                                corner + 1, corner + segments + 1, corner + segments + 2 });
+            }
+        }
+
+        resources.sphereVertices = VertexQuantizer::quantize(positions.data(), normals.data(), texCoords.data(),
+                                                             (unsigned int) positions.size());
+        resources.sphere.create(resources.sphereVertices.data.data(), resources.sphereVertices.vertexCount,
+                                indices.data(), (unsigned int) indices.size(), resources.sphereVertices.layout);
+    }
+
+    struct GoldenScene
+    {
+        const char* name;
+        void (*render)(Resources& resources);
+    };
+
+    const GoldenScene scenes[] = {
+            { "tetrahedron", renderTetrahedron },
+            { "instanced", renderInstanced },
+            { "pool", renderPool },
+            { "quantized", renderQuantized },
+            { "obj", renderObj },
+            { "ply", renderPly },
+            { "gltf", renderGltf }
+    };
+
+    bool createResources(Resources& resources)
+    {
+        resources.tetrahedron.create(tetrahedronVertices, tetrahedronIndices, 12, 12);
+
+        resources.pool.create(12 * 3, 12 * 3);
+        for (int i = 0; i < 3; i++)
+        {
+            float vertices[12];
+            for (int v = 0; v < 12; v++) vertices[v] = tetrahedronVertices[v] * 0.8f;
+            for (int v = 0; v < 4; v++)
+            {
+                vertices[v * 3] += -2.0f + 2.0f * (float) i;
+                vertices[v * 3 + 2] -= (float) i;
+            }
+            resources.pool.add(vertices, tetrahedronIndices, 12, 12);
+        }
+
+        createSphere(resources);
+
+        // 6 faces x 4 corners plus the pentagon's extra one; the duplicated vertex welds away.
+        // 13 triangles: 4 quads and the -y triangles as written, 3 from the pentagon's fan
+        ModelImportOptions quantized;
+        quantized.quantize = true;
+        if (!importModel(cubeModel, quantized, 25, 39, resources.cube)) return false;
+
+        // The prism's two triangles and three quads make 8 triangles
+        if (!importModel(octahedronModel, {}, 6, 24, resources.octahedron)) return false;
+        if (!importModel(prismModel, {}, 6, 24, resources.prism)) return false;
+        if (!loadGltf(resources)) return false;
+
+        resources.shader.createFromFiles(vertexShader, fragmentShader);
+        resources.instancedShader.createFromFiles(instancedVertexShader, fragmentShader);
+        resources.quantizedShader.createFromFiles(quantizedVertexShader, fragmentShader);
+        resources.uniforms.create(16);
+
+        // Same projection as main.cpp
+        resources.frame.projection = glm::perspective(45.0f, (float) imageHeight / (float) imageWidth, 0.1f, 300.0f);
+        return resources.shader.isReady() && resources.instancedShader.isReady() && resources.quantizedShader.isReady();
+    }
+
+    /* Perceptual colour difference in YIQ space (Kotsarenko & Ramos, as used by pixelmatch),
+     * normalised so 0 is identical and 1 is black vs. white. Luma differences weigh the most,
+     * so small chroma shifts from rasterisation or blending precision are tolerated. */
+    float colorDelta(const unsigned char* a, const unsigned char* b)
+    {
+        auto toYIQ = [](const unsigned char* pixel, float& y, float& i, float& q)
+        {
+            // Blend over white so differences in fully transparent pixels don't count
+            float alpha = (float) pixel[3] / 255.0f;
+            float r = 255.0f + ((float) pixel[0] - 255.0f) * alpha;
+            float g = 255.0f + ((float) pixel[1] - 255.0f) * alpha;
+            float bl = 255.0f + ((float) pixel[2] - 255.0f) * alpha;
+
+            y = r * 0.29889531f + g * 0.58662247f + bl * 0.11448223f;
+            i = r * 0.59597799f - g * 0.27417610f - bl * 0.32180189f;
+            q = r * 0.21147017f - g * 0.52261711f + bl * 0.31114694f;
+        };
+
+        float y1, i1, q1, y2, i2, q2;
+        toYIQ(a, y1, i1, q1);
+        toYIQ(b, y2, i2, q2);
+
+        float y = y1 - y2, i = i1 - i2, q = q1 - q2;
+        return (0.5053f * y * y + 0.299f * i * i + 0.1957f * q * q) / 35215.0f;
+    }
+
+    // Returns the fraction of pixels whose difference exceeds threshold and fills in a diff image
+    double compare(const Image& actual, const Image& expected, float threshold, Image& diff)
+    {
+        diff.resize(actual.width, actual.height);
+
+        size_t bad = 0, pixelCount = (size_t) actual.width * actual.height;
+        for (size_t pixel = 0; pixel < pixelCount; pixel++)
+        {
+            const unsigned char* a = actual.pixels.data() + pixel * 4;
+            const unsigned char* e = expected.pixels.data() + pixel * 4;
+            unsigned char* d = diff.pixels.data() + pixel * 4;
+
+            // colorDelta is squared, so square the threshold to keep it linear for the caller
+            if (colorDelta(a, e) > threshold * threshold)
+            {
+                bad++;
+                d[0] = 255; d[1] = 0; d[2] = 0;
+            }
+            else
+            {
+                // Faded greyscale of the expected image for context
+                auto grey = (unsigned char) (191 + (e[0] * 0.3f + e[1] * 0.59f + e[2] * 0.11f) / 4.0f);
+                d[0] = d[1] = d[2] = grey;
+            }
+            d[3] = 255;
+        }
+
+        return (double) bad / (double) pixelCount;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // Command-line options: --update rewrites the references instead of comparing,
+    // --references dir (defaults to tests/golden), --output dir for actual/diff images of failures,
+    // --threshold per-pixel perceptual difference (0-1), --max-diff fraction of pixels allowed over it
+    bool update = false;
+    std::string referenceDir = GOLDEN_DIR, outputDir = ".";
+    float threshold = 0.1f;
+    double maxDiff = 0.001;
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--update") == 0) update = true;
+        else if (strcmp(argv[arg], "--references") == 0 && arg + 1 < argc) referenceDir = argv[++arg];
+        else if (strcmp(argv[arg], "--output") == 0 && arg + 1 < argc) outputDir = argv[++arg];
+        else if (strcmp(argv[arg], "--threshold") == 0 && arg + 1 < argc) threshold = std::strtof(argv[++arg], nullptr);
+        else if (strcmp(argv[arg], "--max-diff") == 0 && arg + 1 < argc) maxDiff = std::strtod(argv[++arg], nullptr);
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--update] [--references dir] [--output dir]"
+                      << " [--threshold T] [--max-diff F]\n";
+            return 1;
+        }
+    }
+
+    GLWindow window(imageWidth, imageHeight, WindowBackend::Headless);
+    if (window.init() != 0) return 1;
+
+    GLStateCache::enable(GL_DEPTH_TEST);
+    glViewport(0, 0, imageWidth, imageHeight);
+
+    Resources resources;
+    if (!createResources(resources))
+    {
+        std::cout << "Could not create test resources\n";
+        return 1;
+    }
+
+    // Render every scene before reading any back; each readback lands while the next scene renders
+    constexpr size_t sceneCount = std::size(scenes);
+    std::unique_ptr<PixelReadback> readbacks[sceneCount];
+    for (size_t i = 0; i < sceneCount; i++)
+    {
+        scenes[i].render(resources);
+
+        readbacks[i] = std::make_unique<PixelReadback>();
+        readbacks[i]->create(imageWidth, imageHeight);
+        readbacks[i]->begin();
+    }
+
+    int failures = 0;
+    for (size_t i = 0; i < sceneCount; i++)
+    {
+        std::string name = scenes[i].name;
+        std::string referencePath = referenceDir + "/" + name + ".png";
+
+        Image actual;
+        actual.setFromFramebuffer(readbacks[i]->map(), imageWidth, imageHeight);
+        readbacks[i]->unmap();
+
+        if (update)
+        {
+            if (!actual.savePNG(referencePath.c_str())) return 1;
+            std::cout << "UPDATED " << name << '\n';
+            continue;
+        }
+
+        Image expected;
+        if (!expected.loadPNG(referencePath.c_str()))
+        {
+            failures++;
+            continue;
+        }
+
+        if (expected.width != actual.width || expected.height != actual.height)
+        {
+            std::cout << "FAIL " << name << ": reference is " << expected.width << 'x' << expected.height
+                      << ", rendered " << actual.width << 'x' << actual.height << '\n';
+            failures++;
+            continue;
+        }
+
+        Image diff;
+        double difference = compare(actual, expected, threshold, diff);
+        if (difference > maxDiff)
+        {
+            std::cout << "FAIL " << name << ": " << difference * 100.0 << "% of pixels differ (allowed "
+                      << maxDiff * 100.0 << "%)\n";
+            actual.savePNG((outputDir + "/" + name + ".actual.png").c_str());
+            diff.savePNG((outputDir + "/" + name + ".diff.png").c_str());
+            failures++;
+        }
+        else
+        {
+            std::cout << "PASS " << name << " (" << difference * 100.0 << "% of pixels differ)\n";
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}